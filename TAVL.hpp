@@ -34,7 +34,10 @@
 #ifndef TAVL_TAVL
 #define TAVL_TAVL
 
+#include <cstdint>
+#include <string_view>
 #include <type_traits>
+#include <utility>
 
 namespace tavl
 {
@@ -51,9 +54,122 @@ namespace tavl
      */
     template <typename L, typename R>
     struct compare;
+    /**
+     * @brief optional ordinal of key K. Keys with ordinals are compared by
+     * comparing their ordinals, without instantiating compare.
+     * @note Specialize it with a static constexpr variable named value whose
+     * type is integral or has a constexpr operator<. compare is still used
+     * when any of the two keys being compared has no ordinal.
+     */
+    template <typename K>
+    struct key_ordinal
+    {
+    };
+    namespace impl
+    {
+        template <typename K, typename = void>
+        inline constexpr bool has_key_ordinal_v = false;
+        template <typename K>
+        inline constexpr bool has_key_ordinal_v<
+            K,
+            std::void_t<decltype(key_ordinal<K>::value)>> = true;
+        template <typename L,
+                  typename R,
+                  bool = has_key_ordinal_v<L>&& has_key_ordinal_v<R>>
+        inline constexpr int compare_select_v =
+            compare<L, R>::value > 0 ? 1 : compare<L, R>::value < 0 ? -1 : 0;
+        template <typename L, typename R>
+        inline constexpr int compare_select_v<L, R, true> =
+            key_ordinal<L>::value < key_ordinal<R>::value ?
+                -1 :
+                key_ordinal<R>::value < key_ordinal<L>::value ? 1 : 0;
+    } // namespace impl
     template <typename L, typename R>
-    static constexpr int compare_v =
-        compare<L, R>::value > 0 ? 1 : compare<L, R>::value < 0 ? -1 : 0;
+    static constexpr int compare_v = impl::compare_select_v<L, R>;
+    namespace impl
+    {
+        template <typename T>
+        constexpr std::string_view type_name()
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            return __FUNCSIG__;
+#else
+            return __PRETTY_FUNCTION__;
+#endif
+        }
+        // FNV-1a
+        constexpr std::uint64_t hash_string(std::string_view str)
+        {
+            std::uint64_t hash = 14695981039346656037ull;
+            for (char c : str)
+                hash = (hash ^ static_cast<unsigned char>(c)) *
+                       1099511628211ull;
+            return hash;
+        }
+    } // namespace impl
+    /**
+     * @brief hash of key K used by tavl_hamt and tavl_treap_policy
+     * @note the default one hashes the name of K printed by the compiler, so
+     * no compare specialization is needed. Specialize it with a static
+     * constexpr std::uint64_t variable named value to use a hash of your own.
+     */
+    template <typename K>
+    struct key_hash
+    {
+        static constexpr std::uint64_t value =
+            impl::hash_string(impl::type_name<K>());
+    };
+#if __cpp_nontype_template_args >= 201911L
+    /**
+     * @brief string literal which can be used as a non-type template argument
+     */
+    template <std::size_t N>
+    struct string_literal
+    {
+        char data[N];
+        constexpr string_literal(const char (&str)[N]) : data{}
+        {
+            for (std::size_t i = 0; i < N; ++i)
+                data[i] = str[i];
+        }
+    };
+    /**
+     * @brief string key, used as fixed_string<"name">
+     * @note keys are compared as std::string_view by key_ordinal, that is a
+     * single constexpr evaluation instead of an instantiation per character.
+     */
+    template <string_literal Str>
+    struct fixed_string
+    {
+        static constexpr std::string_view value{Str.data,
+                                                sizeof(Str.data) - 1};
+    };
+    template <string_literal Str>
+    struct key_ordinal<fixed_string<Str>>
+    {
+        static constexpr std::string_view value = fixed_string<Str>::value;
+    };
+#else
+    /**
+     * @brief string key, used as fixed_string<'n', 'a', 'm', 'e'>
+     * @note keys are compared as std::string_view by key_ordinal, that is a
+     * single constexpr evaluation instead of an instantiation per character.
+     */
+    template <char... chars>
+    struct fixed_string
+    {
+    private:
+        static constexpr char data[] = {chars..., '\0'};
+
+    public:
+        static constexpr std::string_view value{data, sizeof...(chars)};
+    };
+    template <char... chars>
+    struct key_ordinal<fixed_string<chars...>>
+    {
+        static constexpr std::string_view value = fixed_string<chars...>::value;
+    };
+#endif
     // for lazy evaluation
     template <typename T>
     struct identity
@@ -98,6 +214,7 @@ namespace tavl
         static constexpr int height = -1;
         using key                   = void;
         using value                 = void;
+        static constexpr std::size_t size = 0;
     };
     template <typename T>
     static constexpr bool is_empty_node_v = std::is_same_v<T, empty_node>;
@@ -113,6 +230,9 @@ namespace tavl
      * @tparam K key. Note that compare should be properly specialized for all
      * keys.
      * @tparam V value
+     * @note size, the number of elements in this tree, is only computed when
+     * it is used and then memoized with the node type, so nodes rebuilt by
+     * insert/remove/rotations only compute it for the rebuilt path.
      */
     template <typename L,
               typename R,
@@ -126,12 +246,14 @@ namespace tavl
         static constexpr int height = H;
         using key                   = K;
         using value                 = V;
+        static constexpr std::size_t size = L::size + R::size + 1;
     };
 
 #if __cplusplus > 201703L && __cpp_concepts >= 201907L
     // concepts for C++2a
     template <typename L, typename R>
-    concept Comparable = requires
+    concept Comparable =
+        (impl::has_key_ordinal_v<L> && impl::has_key_ordinal_v<R>) || requires
     {
         compare<L, R>::value + 0;
     };
@@ -285,6 +407,14 @@ namespace tavl
     using tavl_max_t = typename tavl_max<T>::type;
     namespace impl
     {
+        template <typename L, typename R, typename K, typename V>
+        using make_node_t = tavl_node<L,
+                                      R,
+                                      (L::height > R::height ? L::height + 1 :
+                                                               R::height + 1),
+                                      K,
+                                      V>;
+#ifdef TAVL_LEGACY_INSERT_IMPL
         template <typename TREE>
         using insert_reset_height =
             tavl_node<typename TREE::left,
@@ -313,8 +443,8 @@ namespace tavl
         template <typename T, typename K, typename V>
         struct insert_impl<T, K, V, 0>
         {
-            // K is existed
-            using type = Impl::invalid;
+            // K is existed, T is kept as it is
+            using type = T;
         };
         template <typename TREE, typename KL, typename VL>
         struct insert_recursive_left
@@ -412,29 +542,329 @@ namespace tavl
         {
             using type = typename insert_right_impl<T, K, V>::type;
         };
+        template <typename T, typename K, typename V>
+        struct insert_engine
+        {
+            using type =
+                insert_reset_height<typename insert_impl<T, K, V>::type>;
+        };
+#else
+        /**
+         * @brief order of K against the key of T, or 2 if T is empty and K
+         * should be placed there.
+         */
+        template <typename K, typename T>
+        inline constexpr int insert_order_v = compare_v<K, typename T::key>;
+        template <typename K>
+        inline constexpr int insert_order_v<K, empty_node> = 2;
+        /**
+         * @brief rebalancing action once the left child of T has been
+         * replaced by C: 0 for none, 1 for single rotation, 2 for double
+         * rotation.
+         */
+        template <typename T, typename C>
+        inline constexpr int insert_action_left_v =
+            C::height - T::right::height != 2 ?
+                0 :
+                (C::left::height > C::right::height ? 1 : 2);
+        /**
+         * @brief mirror of insert_action_left_v for the right child.
+         */
+        template <typename T, typename C>
+        inline constexpr int insert_action_right_v =
+            C::height - T::left::height != 2 ?
+                0 :
+                (C::right::height > C::left::height ? 1 : 2);
+        /**
+         * @brief build the node replacing T, whose left child became C
+         * @note Every node is built exactly once. Heights are computed from
+         * the children, so T may have been built under any policy.
+         */
+        template <typename T,
+                  typename C,
+                  int = insert_action_left_v<T, C>>
+        struct insert_rebuild_left
+        {
+            using type = make_node_t<C,
+                                     typename T::right,
+                                     typename T::key,
+                                     typename T::value>;
+        };
+        template <typename T, typename C>
+        struct insert_rebuild_left<T, C, 1>
+        {
+            using type = make_node_t<typename C::left,
+                                     make_node_t<typename C::right,
+                                                 typename T::right,
+                                                 typename T::key,
+                                                 typename T::value>,
+                                     typename C::key,
+                                     typename C::value>;
+        };
+        template <typename T, typename C>
+        struct insert_rebuild_left<T, C, 2>
+        {
+            using type = make_node_t<make_node_t<typename C::left,
+                                                 typename C::right::left,
+                                                 typename C::key,
+                                                 typename C::value>,
+                                     make_node_t<typename C::right::right,
+                                                 typename T::right,
+                                                 typename T::key,
+                                                 typename T::value>,
+                                     typename C::right::key,
+                                     typename C::right::value>;
+        };
+        /**
+         * @brief mirror of insert_rebuild_left for the right child.
+         */
+        template <typename T,
+                  typename C,
+                  int = insert_action_right_v<T, C>>
+        struct insert_rebuild_right
+        {
+            using type = make_node_t<typename T::left,
+                                     C,
+                                     typename T::key,
+                                     typename T::value>;
+        };
+        template <typename T, typename C>
+        struct insert_rebuild_right<T, C, 1>
+        {
+            using type = make_node_t<make_node_t<typename T::left,
+                                                 typename C::left,
+                                                 typename T::key,
+                                                 typename T::value>,
+                                     typename C::right,
+                                     typename C::key,
+                                     typename C::value>;
+        };
+        template <typename T, typename C>
+        struct insert_rebuild_right<T, C, 2>
+        {
+            using type = make_node_t<make_node_t<typename T::left,
+                                                 typename C::left::left,
+                                                 typename T::key,
+                                                 typename T::value>,
+                                     make_node_t<typename C::left::right,
+                                                 typename C::right,
+                                                 typename C::key,
+                                                 typename C::value>,
+                                     typename C::left::key,
+                                     typename C::left::value>;
+        };
+        /**
+         * @brief one level of insertion: K is compared once, the child is
+         * computed once and the node is rebuilt once.
+         */
+        template <typename T,
+                  typename K,
+                  typename V,
+                  int = insert_order_v<K, T>>
+        struct insert_engine
+        {
+            using type = typename insert_rebuild_left<
+                T,
+                typename insert_engine<typename T::left, K, V>::type>::type;
+        };
+        template <typename T, typename K, typename V>
+        struct insert_engine<T, K, V, 1>
+        {
+            using type = typename insert_rebuild_right<
+                T,
+                typename insert_engine<typename T::right, K, V>::type>::type;
+        };
+        template <typename T, typename K, typename V>
+        struct insert_engine<T, K, V, 2>
+        {
+            using type = tavl_node<empty_node, empty_node, 0, K, V>;
+        };
+        template <typename T, typename K, typename V>
+        struct insert_engine<T, K, V, 0>
+        {
+            // K is existed, T is kept as it is
+            using type = T;
+        };
+#endif
+    } // namespace impl
+    struct tavl_avl_policy;
+    namespace impl
+    {
+        template <typename Policy, typename T, typename K, typename V>
+        struct policy_insert;
+        template <typename Policy, typename T, typename K>
+        struct policy_remove;
     } // namespace impl
     /**
      * @brief insert an (K, V) element into given AVL tree T
+     * @tparam Policy balancing scheme, see tavl_avl_policy
+     * @note If K is existed, type is T itself and changed is false, so
+     * whether anything is inserted can be told without comparing trees.
      */
-    template <Node T, KeyType K, typename V = std::true_type>
+    template <Node     T,
+              KeyType  K,
+              typename V      = std::true_type,
+              typename Policy = tavl_avl_policy>
     struct tavl_insert
     {
     public:
-        using type = impl::insert_reset_height<
-            typename impl::insert_impl<T, K, V>::type>;
+        using type = typename impl::policy_insert<Policy, T, K, V>::type;
+        static constexpr bool changed = !std::is_same_v<type, T>;
     };
-    template <KeyType K, typename V>
-    struct tavl_insert<empty_node, K, V>
+    template <KeyType K, typename V, typename Policy>
+    struct tavl_insert<empty_node, K, V, Policy>
     {
-        using type = tavl_node<empty_node, empty_node, 0, K, V>;
+        using type                    = tavl_node<empty_node,
+                                                  empty_node,
+                                                  0,
+                                                  K,
+                                                  V>;
+        static constexpr bool changed = true;
     };
     /**
      * @brief insert an (K, V) element into given AVL tree T
      */
-    template <typename T, typename K, typename V = std::true_type>
-    using tavl_insert_t = typename tavl_insert<T, K, V>::type;
+    template <typename T,
+              typename K,
+              typename V      = std::true_type,
+              typename Policy = tavl_avl_policy>
+    using tavl_insert_t = typename tavl_insert<T, K, V, Policy>::type;
     namespace impl
     {
+        /**
+         * @brief order of K against the key of T, or 2 if T is empty and K
+         * is not found.
+         */
+        template <typename K, typename T>
+        inline constexpr int key_order_v = compare_v<K, typename T::key>;
+        template <typename K>
+        inline constexpr int key_order_v<K, empty_node> = 2;
+        /**
+         * @brief rebalancing action for a node with children L and R whose
+         * heights differ by at most 2: 0 for none, 1 (-1) for single rotation
+         * to the right (left), 2 (-2) for double rotation.
+         */
+        template <typename L, typename R>
+        inline constexpr int balance_action_v =
+            L::height - R::height == 2 ?
+                (L::left::height >= L::right::height ? 1 : 2) :
+                R::height - L::height == 2 ?
+                (R::right::height >= R::left::height ? -1 : -2) :
+                0;
+        /**
+         * @brief build a balanced node from L, (K, V) and R, where the heights
+         * of L and R differ by at most 2
+         */
+        template <typename L,
+                  typename R,
+                  typename K,
+                  typename V,
+                  int = balance_action_v<L, R>>
+        struct balance
+        {
+            using type = make_node_t<L, R, K, V>;
+        };
+        template <typename L, typename R, typename K, typename V>
+        struct balance<L, R, K, V, 1>
+        {
+            using type = make_node_t<typename L::left,
+                                     make_node_t<typename L::right, R, K, V>,
+                                     typename L::key,
+                                     typename L::value>;
+        };
+        template <typename L, typename R, typename K, typename V>
+        struct balance<L, R, K, V, 2>
+        {
+            using type = make_node_t<make_node_t<typename L::left,
+                                                 typename L::right::left,
+                                                 typename L::key,
+                                                 typename L::value>,
+                                     make_node_t<typename L::right::right,
+                                                 R,
+                                                 K,
+                                                 V>,
+                                     typename L::right::key,
+                                     typename L::right::value>;
+        };
+        template <typename L, typename R, typename K, typename V>
+        struct balance<L, R, K, V, -1>
+        {
+            using type = make_node_t<make_node_t<L, typename R::left, K, V>,
+                                     typename R::right,
+                                     typename R::key,
+                                     typename R::value>;
+        };
+        template <typename L, typename R, typename K, typename V>
+        struct balance<L, R, K, V, -2>
+        {
+            using type = make_node_t<make_node_t<L,
+                                                 typename R::left::left,
+                                                 K,
+                                                 V>,
+                                     make_node_t<typename R::left::right,
+                                                 typename R::right,
+                                                 typename R::key,
+                                                 typename R::value>,
+                                     typename R::left::key,
+                                     typename R::left::value>;
+        };
+        template <typename L, typename R, typename K, typename V>
+        using balance_t = typename balance<L, R, K, V>::type;
+        /**
+         * @brief remove the minimal element of the non-empty tree T in one
+         * descent, rebalancing with Policy
+         * @note min is the removed element as a kv_pair, rest is the
+         * rebalanced remaining tree
+         */
+        template <typename T, typename Policy = tavl_avl_policy>
+        struct extract_min
+        {
+        private:
+            using left_part = extract_min<typename T::left, Policy>;
+
+        public:
+            using min  = typename left_part::min;
+            using rest = typename balance<
+                typename left_part::rest,
+                typename T::right,
+                typename T::key,
+                typename T::value,
+                Policy::template rotation_v<typename left_part::rest,
+                                            typename T::right,
+                                            typename T::key>>::type;
+        };
+        template <typename R, int H, typename K, typename V, typename Policy>
+        struct extract_min<tavl_node<empty_node, R, H, K, V>, Policy>
+        {
+            using min  = tavl_node<empty_node, empty_node, 0, K, V>;
+            using rest = R;
+        };
+        /**
+         * @brief remove the maximal element of the non-empty tree T in one
+         * descent
+         * @note max is the removed element as a kv_pair, rest is the
+         * rebalanced remaining tree
+         */
+        template <typename T>
+        struct extract_max
+        {
+        private:
+            using right_part = extract_max<typename T::right>;
+
+        public:
+            using max  = typename right_part::max;
+            using rest = balance_t<typename T::left,
+                                   typename right_part::rest,
+                                   typename T::key,
+                                   typename T::value>;
+        };
+        template <typename L, int H, typename K, typename V>
+        struct extract_max<tavl_node<L, empty_node, H, K, V>>
+        {
+            using max  = tavl_node<empty_node, empty_node, 0, K, V>;
+            using rest = L;
+        };
+#ifdef TAVL_LEGACY_REMOVE_IMPL
         template <typename TREE>
         struct remove_reset_height
         {
@@ -610,27 +1040,398 @@ namespace tavl
         {
             using type = typename remove_left<T, K>::type;
         };
+        template <typename T, typename K>
+        struct remove_engine
+        {
+            using type =
+                remove_reset_height_t<typename remove_impl<T, K>::type>;
+        };
+#else
+        /**
+         * @brief remove the root of T, which is replaced by its successor
+         */
+        template <typename T>
+        struct remove_root
+        {
+        private:
+            using successor = extract_min<typename T::right>;
+
+        public:
+            using type = balance_t<typename T::left,
+                                   typename successor::rest,
+                                   typename successor::min::key,
+                                   typename successor::min::value>;
+        };
+        template <typename R, int H, typename K, typename V>
+        struct remove_root<tavl_node<empty_node, R, H, K, V>>
+        {
+            using type = R;
+        };
+        template <typename L, int H, typename K, typename V>
+        struct remove_root<tavl_node<L, empty_node, H, K, V>>
+        {
+            using type = L;
+        };
+        template <int H, typename K, typename V>
+        struct remove_root<tavl_node<empty_node, empty_node, H, K, V>>
+        {
+            using type = empty_node;
+        };
+        /**
+         * @brief one level of removal: K is compared once, the child is
+         * computed once and the node is rebalanced once.
+         */
+        template <typename T, typename K, int = key_order_v<K, T>>
+        struct remove_engine
+        {
+            using type =
+                balance_t<typename remove_engine<typename T::left, K>::type,
+                          typename T::right,
+                          typename T::key,
+                          typename T::value>;
+        };
+        template <typename T, typename K>
+        struct remove_engine<T, K, 1>
+        {
+            using type =
+                balance_t<typename T::left,
+                          typename remove_engine<typename T::right, K>::type,
+                          typename T::key,
+                          typename T::value>;
+        };
+        template <typename T, typename K>
+        struct remove_engine<T, K, 0>
+        {
+            using type = typename remove_root<T>::type;
+        };
+        template <typename T, typename K>
+        struct remove_engine<T, K, 2>
+        {
+            // K is not found
+            using type = empty_node;
+        };
+#endif
+    } // namespace impl
+    namespace impl
+    {
+        /**
+         * @brief join L and R, whose parent was removed, by moving the
+         * successor up
+         */
+        template <typename Policy, typename L, typename R>
+        struct successor_concat
+        {
+        private:
+            using successor = extract_min<R, Policy>;
+
+        public:
+            using type = typename balance<
+                L,
+                typename successor::rest,
+                typename successor::min::key,
+                typename successor::min::value,
+                Policy::template rotation_v<L,
+                                            typename successor::rest,
+                                            typename successor::min::key>>::
+                type;
+        };
+        template <typename Policy, typename L>
+        struct successor_concat<Policy, L, empty_node>
+        {
+            using type = L;
+        };
+        template <typename Policy, typename R>
+        struct successor_concat<Policy, empty_node, R>
+        {
+            using type = R;
+        };
+        template <typename Policy>
+        struct successor_concat<Policy, empty_node, empty_node>
+        {
+            using type = empty_node;
+        };
+        template <typename K>
+        inline constexpr std::uint64_t treap_priority_v = key_hash<K>::value;
+        /**
+         * @brief 0 (1) if L (R) is empty, otherwise 2 (3) if the root of L
+         * (R) should be the root of the result
+         */
+        template <typename L, typename R>
+        inline constexpr int treap_concat_action_v =
+            is_empty_node_v<L> ?
+                0 :
+                is_empty_node_v<R> ?
+                1 :
+                treap_priority_v<typename L::key> >
+                        treap_priority_v<typename R::key> ?
+                2 :
+                3;
+        /**
+         * @brief join L and R, whose parent was removed, by merging their
+         * right and left spines in the order of priorities
+         */
+        template <typename L, typename R, int = treap_concat_action_v<L, R>>
+        struct treap_concat
+        {
+            using type = R;
+        };
+        template <typename L, typename R>
+        struct treap_concat<L, R, 1>
+        {
+            using type = L;
+        };
+        template <typename L, typename R>
+        struct treap_concat<L, R, 2>
+        {
+            using type = make_node_t<
+                typename L::left,
+                typename treap_concat<typename L::right, R>::type,
+                typename L::key,
+                typename L::value>;
+        };
+        template <typename L, typename R>
+        struct treap_concat<L, R, 3>
+        {
+            using type =
+                make_node_t<typename treap_concat<L, typename R::left>::type,
+                            typename R::right,
+                            typename R::key,
+                            typename R::value>;
+        };
+        // the rotation of a weight-balanced tree, see tavl_weight_policy
+        template <typename L, typename R>
+        inline constexpr int weight_rotation_v =
+            L::size + R::size <= 1 ?
+                0 :
+                R::size > 3 * L::size ?
+                (R::left::size < 2 * R::right::size ? -1 : -2) :
+                L::size > 3 * R::size ?
+                (L::right::size < 2 * L::left::size ? 1 : 2) :
+                0;
+        // the rotation of a treap, see tavl_treap_policy
+        template <typename L, typename R, typename K>
+        inline constexpr int treap_rotation_v =
+            !is_empty_node_v<L> &&
+                    treap_priority_v<typename L::key> > treap_priority_v<K> ?
+                1 :
+                !is_empty_node_v<R> &&
+                        treap_priority_v<typename R::key> >
+                            treap_priority_v<K> ?
+                -1 :
+                0;
+    } // namespace impl
+    /**
+     * @brief balancing policy of AVL trees, used by default
+     * @note A policy provides rotation_v<L, R, K>, the rotation (see
+     * impl::balance) of a node built from L, K and R after one of L and R
+     * was changed by a single insertion or removal, and concat<L, R>, whose
+     * type joins L and R after their parent was removed. Heights of nodes
+     * are computed from their children under every policy, but only the
+     * policy which built a tree keeps it balanced, so a tree should keep
+     * using that policy for insertions and removals.
+     */
+    struct tavl_avl_policy
+    {
+        template <typename L, typename R, typename K>
+        static constexpr int rotation_v = impl::balance_action_v<L, R>;
+        template <typename L, typename R>
+        using concat = impl::successor_concat<tavl_avl_policy, L, R>;
+    };
+    /**
+     * @brief balancing policy of weight-balanced trees (delta = 3, ratio = 2)
+     * @note the size of a child is at most about 3 times the size of its
+     * sibling, so sizes are what keep the tree balanced and heights are never
+     * compared.
+     */
+    struct tavl_weight_policy
+    {
+        template <typename L, typename R, typename K>
+        static constexpr int rotation_v = impl::weight_rotation_v<L, R>;
+        template <typename L, typename R>
+        using concat = impl::successor_concat<tavl_weight_policy, L, R>;
+    };
+    /**
+     * @brief balancing policy of treaps whose priorities are the key_hash of
+     * keys
+     * @note a node has a greater priority than its children, so the shape of
+     * a tree only depends on its keys: the same set of elements always gives
+     * the same type, whatever the order of insertions and removals is (as
+     * long as no two keys have the same hash).
+     */
+    struct tavl_treap_policy
+    {
+        template <typename L, typename R, typename K>
+        static constexpr int rotation_v = impl::treap_rotation_v<L, R, K>;
+        template <typename L, typename R>
+        using concat = impl::treap_concat<L, R>;
+    };
+    namespace impl
+    {
+        template <typename Policy,
+                  typename L,
+                  typename R,
+                  typename K,
+                  typename V>
+        using policy_balance_t = typename balance<
+            L,
+            R,
+            K,
+            V,
+            Policy::template rotation_v<L, R, K>>::type;
+        /**
+         * @brief one level of insertion rebalanced by Policy
+         */
+        template <typename Policy,
+                  typename T,
+                  typename K,
+                  typename V,
+                  int = key_order_v<K, T>>
+        struct policy_insert_engine
+        {
+            using type = policy_balance_t<
+                Policy,
+                typename policy_insert_engine<Policy,
+                                              typename T::left,
+                                              K,
+                                              V>::type,
+                typename T::right,
+                typename T::key,
+                typename T::value>;
+        };
+        template <typename Policy, typename T, typename K, typename V>
+        struct policy_insert_engine<Policy, T, K, V, 1>
+        {
+            using type = policy_balance_t<
+                Policy,
+                typename T::left,
+                typename policy_insert_engine<Policy,
+                                              typename T::right,
+                                              K,
+                                              V>::type,
+                typename T::key,
+                typename T::value>;
+        };
+        template <typename Policy, typename T, typename K, typename V>
+        struct policy_insert_engine<Policy, T, K, V, 2>
+        {
+            using type = tavl_node<empty_node, empty_node, 0, K, V>;
+        };
+        template <typename Policy, typename T, typename K, typename V>
+        struct policy_insert_engine<Policy, T, K, V, 0>
+        {
+            // K is existed, T is kept as it is
+            using type = T;
+        };
+        template <typename Policy, typename T, typename K, typename V>
+        struct policy_insert : policy_insert_engine<Policy, T, K, V>
+        {
+        };
+        template <typename T, typename K, typename V>
+        struct policy_insert<tavl_avl_policy, T, K, V>
+            : insert_engine<T, K, V>
+        {
+        };
+        /**
+         * @brief one level of removal rebalanced by Policy
+         */
+        template <typename Policy,
+                  typename T,
+                  typename K,
+                  int = key_order_v<K, T>>
+        struct policy_remove_engine
+        {
+            using type = policy_balance_t<
+                Policy,
+                typename policy_remove_engine<Policy, typename T::left, K>::
+                    type,
+                typename T::right,
+                typename T::key,
+                typename T::value>;
+        };
+        template <typename Policy, typename T, typename K>
+        struct policy_remove_engine<Policy, T, K, 1>
+        {
+            using type = policy_balance_t<
+                Policy,
+                typename T::left,
+                typename policy_remove_engine<Policy, typename T::right, K>::
+                    type,
+                typename T::key,
+                typename T::value>;
+        };
+        template <typename Policy, typename T, typename K>
+        struct policy_remove_engine<Policy, T, K, 0>
+        {
+            using type = typename Policy::
+                template concat<typename T::left, typename T::right>::type;
+        };
+        template <typename Policy, typename T, typename K>
+        struct policy_remove_engine<Policy, T, K, 2>
+        {
+            // K is not found
+            using type = empty_node;
+        };
+        template <typename Policy, typename T, typename K>
+        struct policy_remove : policy_remove_engine<Policy, T, K>
+        {
+        };
+        template <typename T, typename K>
+        struct policy_remove<tavl_avl_policy, T, K> : remove_engine<T, K>
+        {
+        };
     } // namespace impl
     /**
      * @brief try to remopve the element whose key is K
+     * @tparam Policy balancing scheme, see tavl_avl_policy
      */
-    template <Node T, KeyType K>
+    template <Node T, KeyType K, typename Policy = tavl_avl_policy>
     struct tavl_remove
     {
     public:
-        using type =
-            impl::remove_reset_height_t<typename impl::remove_impl<T, K>::type>;
+        using type = typename impl::policy_remove<Policy, T, K>::type;
     };
-    template <KeyType K>
-    struct tavl_remove<empty_node, K>
+    template <KeyType K, typename Policy>
+    struct tavl_remove<empty_node, K, Policy>
     {
         using type = empty_node;
     };
     /**
      * @brief try to remopve the element whose key is K
      */
-    template <typename T, typename K>
-    using tavl_remove_t = typename tavl_remove<T, K>::type;
+    template <typename T, typename K, typename Policy = tavl_avl_policy>
+    using tavl_remove_t = typename tavl_remove<T, K, Policy>::type;
+    /**
+     * @brief remove the minimal element of T in one descent of its left
+     * spine
+     * @note min is the removed element as a kv_pair, rest is the rebalanced
+     * remaining AVL tree. Both are empty_node if T is empty.
+     */
+    template <Node T>
+    struct tavl_pop_min : impl::extract_min<T>
+    {
+    };
+    template <>
+    struct tavl_pop_min<empty_node>
+    {
+        using min  = empty_node;
+        using rest = empty_node;
+    };
+    /**
+     * @brief remove the maximal element of T in one descent of its right
+     * spine
+     * @note max is the removed element as a kv_pair, rest is the rebalanced
+     * remaining AVL tree. Both are empty_node if T is empty.
+     */
+    template <Node T>
+    struct tavl_pop_max : impl::extract_max<T>
+    {
+    };
+    template <>
+    struct tavl_pop_max<empty_node>
+    {
+        using max  = empty_node;
+        using rest = empty_node;
+    };
     /**
      * @brief default implementation of merging function for tavl_for_each
      */
@@ -859,39 +1660,1317 @@ namespace tavl
               typename Init = void>
     using tavl_for_each_middle_order_t =
         typename tavl_for_each_middle_order<T, F, M, Init>::type;
-    /**
-     * @brief create intersections between multiple trees
-     * @tparam T1 the first tree to examine
-     * @tparam Trees other trees
-     * @note Trees can be empty
+    namespace impl
+    {
+        template <typename T,
+                  template <typename K, typename V>
+                  typename Pred,
+                  typename Left>
+        struct find_if_node
+        {
+            using type = Left;
+        };
+        template <typename T,
+                  template <typename K, typename V>
+                  typename Pred>
+        struct find_if_impl
+            : find_if_node<T,
+                           Pred,
+                           typename find_if_impl<typename T::left, Pred>::type>
+        {
+        };
+        template <template <typename K, typename V> typename Pred>
+        struct find_if_impl<empty_node, Pred>
+        {
+            using type = empty_node;
+        };
+        template <typename T,
+                  template <typename K, typename V>
+                  typename Pred,
+                  bool = Pred<typename T::key, typename T::value>::value>
+        struct find_if_current
+        {
+            using type = T;
+        };
+        template <typename T,
+                  template <typename K, typename V>
+                  typename Pred>
+        struct find_if_current<T, Pred, false>
+            : find_if_impl<typename T::right, Pred>
+        {
+        };
+        // nothing is found in the left child, try the node itself
+        template <typename T,
+                  template <typename K, typename V>
+                  typename Pred>
+        struct find_if_node<T, Pred, empty_node> : find_if_current<T, Pred>
+        {
+        };
+        template <template <typename K, typename V> typename Pred>
+        struct negate_pred
+        {
+            template <typename K, typename V>
+            using type = std::bool_constant<!Pred<K, V>::value>;
+        };
+        template <typename T,
+                  template <typename S, typename K, typename V>
+                  typename F,
+                  typename S>
+        struct fold_until_impl;
+        template <typename T,
+                  template <typename S, typename K, typename V>
+                  typename F,
+                  typename Step,
+                  bool = Step::done>
+        struct fold_until_step
+        {
+            using type                 = typename Step::type;
+            static constexpr bool done = true;
+        };
+        template <typename T,
+                  template <typename S, typename K, typename V>
+                  typename F,
+                  typename Step>
+        struct fold_until_step<T, F, Step, false>
+            : fold_until_impl<typename T::right, F, typename Step::type>
+        {
+        };
+        template <typename T,
+                  template <typename S, typename K, typename V>
+                  typename F,
+                  typename Left,
+                  bool = Left::done>
+        struct fold_until_node
+        {
+            using type                 = typename Left::type;
+            static constexpr bool done = true;
+        };
+        template <typename T,
+                  template <typename S, typename K, typename V>
+                  typename F,
+                  typename Left>
+        struct fold_until_node<T, F, Left, false>
+            : fold_until_step<
+                  T,
+                  F,
+                  F<typename Left::type, typename T::key, typename T::value>>
+        {
+        };
+        template <typename T,
+                  template <typename S, typename K, typename V>
+                  typename F,
+                  typename S>
+        struct fold_until_impl
+            : fold_until_node<T, F, fold_until_impl<typename T::left, F, S>>
+        {
+        };
+        template <template <typename S, typename K, typename V> typename F,
+                  typename S>
+        struct fold_until_impl<empty_node, F, S>
+        {
+            using type                 = S;
+            static constexpr bool done = false;
+        };
+    } // namespace impl
+    /**
+     * @brief the first element in the middle order whose Pred<key,
+     * value>::value is true. Return the sub-tree with it as its root,
+     * empty_node if there is no such element.
+     * @tparam T AVL tree
+     * @tparam Pred predicate with a boolean member named value
+     * @note Pred is not instantiated for elements after the found one, and
+     * no sub-tree after it is visited.
      */
-    template <Node T1, Node... Trees>
-    struct tavl_intersect
+    template <Node T, template <typename K, typename V> typename Pred>
+    using tavl_find_if_t = typename impl::find_if_impl<T, Pred>::type;
+    /**
+     * @brief whether Pred<key, value>::value is true for any element of T
+     * @note stops at the first element satisfying Pred, see tavl_find_if_t
+     */
+    template <Node T, template <typename K, typename V> typename Pred>
+    inline constexpr bool tavl_any_of_v =
+        !std::is_same_v<tavl_find_if_t<T, Pred>, empty_node>;
+    /**
+     * @brief whether Pred<key, value>::value is true for all elements of T
+     * @note stops at the first element not satisfying Pred
+     */
+    template <Node T, template <typename K, typename V> typename Pred>
+    inline constexpr bool tavl_all_of_v =
+        !tavl_any_of_v<T, impl::negate_pred<Pred>::template type>;
+    /**
+     * @brief whether Pred<key, value>::value is false for all elements of T
+     * @note stops at the first element satisfying Pred
+     */
+    template <Node T, template <typename K, typename V> typename Pred>
+    inline constexpr bool tavl_none_of_v = !tavl_any_of_v<T, Pred>;
+    /**
+     * @brief fold the elements of T in the middle order with F until F
+     * decides to stop
+     * @tparam T AVL tree
+     * @tparam F 'function' applied as F<state, key, value>, which should have
+     * a member type named type (the next state) and a boolean member named
+     * done. Once done is true, the remaining elements are skipped.
+     * @tparam Init initial state
+     * @note type is the final state, done tells whether F stopped early.
+     */
+    template <Node T,
+              template <typename S, typename K, typename V>
+              typename F,
+              typename Init>
+    struct tavl_fold_until : impl::fold_until_impl<T, F, Init>
     {
-    private:
-        template <typename Key, typename Value>
-        struct for_each_node
+    };
+    template <typename T,
+              template <typename S, typename K, typename V>
+              typename F,
+              typename Init>
+    using tavl_fold_until_t = typename tavl_fold_until<T, F, Init>::type;
+    namespace impl
+    {
+        // singly linked list of types used by bulk algorithms. Every suffix
+        // of a list is a type of its own, so walking a list never creates
+        // new types.
+        struct list_nil
+        {
+        };
+        template <typename Head, typename Tail>
+        struct list_cons
+        {
+            using head = Head;
+            using tail = Tail;
+        };
+        template <typename... Ts>
+        struct type_pack
+        {
+        };
+#if defined(__has_builtin)
+#if __has_builtin(__type_pack_element)
+#define TAVL_HAS_TYPE_PACK_ELEMENT
+#endif
+#endif
+#ifdef TAVL_HAS_TYPE_PACK_ELEMENT
+        // list view over a pack, indexed with the builtin (clang limits the
+        // length of fold expressions)
+        template <typename Pack, std::size_t I>
+        struct list_pack_cursor;
+        template <typename... Ts, std::size_t I>
+        struct list_pack_cursor<type_pack<Ts...>, I>
+        {
+            using head = __type_pack_element<I, Ts...>;
+            using tail =
+                std::conditional_t<I + 1 == sizeof...(Ts),
+                                   list_nil,
+                                   list_pack_cursor<type_pack<Ts...>, I + 1>>;
+        };
+        template <typename... Ts>
+        struct list_from_pack
         {
-            using type = std::conditional_t<(tavl_contain_v<Trees, Key> && ...),
-                                            type_pair<Key, Value>,
-                                            int>;
+            using type = list_pack_cursor<type_pack<Ts...>, 0>;
         };
-        template <typename Previous, typename Current>
-        struct merger
+        template <>
+        struct list_from_pack<>
+        {
+            using type = list_nil;
+        };
+#else
+        // operator= is never found by ADL, so folding over it costs O(1) per
+        // element and no nested instantiations
+        template <typename T>
+        struct list_prepend
         {
-            using type = tavl_insert_t<Previous,
-                                       typename Current::first_type,
-                                       typename Current::second_type>;
+            template <typename List>
+            list_cons<T, List> operator=(List) const;
         };
-        template <typename Previous>
-        struct merger<Previous, int>
+        template <typename... Ts>
+        struct list_from_pack
         {
-            using type = Previous;
+            using type = decltype((list_prepend<Ts>{} = ... = list_nil{}));
         };
+#endif
+        template <typename... Ts>
+        using list_from_pack_t = typename list_from_pack<Ts...>::type;
+        template <typename P1, typename P2>
+        struct pack_concat;
+        template <typename... As, typename... Bs>
+        struct pack_concat<type_pack<As...>, type_pack<Bs...>>
+        {
+            using type = type_pack<As..., Bs...>;
+        };
+        template <typename Pack, template <typename...> typename To>
+        struct pack_rewrap;
+        template <typename... Ts, template <typename...> typename To>
+        struct pack_rewrap<type_pack<Ts...>, To>
+        {
+            using type = To<Ts...>;
+        };
+        /**
+         * @brief collect the first N elements of L into a type_pack (in the
+         * reversed order if Reverse is true)
+         */
+        template <typename L, std::size_t N, bool Reverse = false>
+        struct list_to_pack
+        {
+        private:
+            using first = list_to_pack<L, N / 2, Reverse>;
+            using second =
+                list_to_pack<typename first::rest, N - N / 2, Reverse>;
 
-    public:
+        public:
+            using type = typename std::conditional_t<
+                Reverse,
+                pack_concat<typename second::type, typename first::type>,
+                pack_concat<typename first::type,
+                            typename second::type>>::type;
+            using rest = typename second::rest;
+        };
+        template <typename L, bool Reverse>
+        struct list_to_pack<L, 1, Reverse>
+        {
+            using type = type_pack<typename L::head>;
+            using rest = typename L::tail;
+        };
+        template <typename L, bool Reverse>
+        struct list_to_pack<L, 0, Reverse>
+        {
+            using type = type_pack<>;
+            using rest = L;
+        };
+        // drives a state machine: S::next is evaluated N times by left folds
+        // over operator=, so the steps are not nested in the template depth.
+        // Folds are cut into blocks since some compilers limit their length.
+        template <typename S>
+        struct iterate_state
+        {
+            using type = S;
+            template <typename Tag>
+            iterate_state<typename S::next> operator=(Tag) const;
+        };
+        template <std::size_t>
+        struct iterate_tag
+        {
+        };
+        template <typename S, typename Seq>
+        struct iterate_fold;
+        template <typename S, std::size_t... Is>
+        struct iterate_fold<S, std::index_sequence<Is...>>
+        {
+            using type = typename decltype(
+                (iterate_state<S>{} = ... = iterate_tag<Is>{}))::type;
+        };
+        inline constexpr std::size_t iterate_block_size = 128;
+        template <typename S,
+                  std::size_t N,
+                  bool = (N <= iterate_block_size)>
+        struct iterate
+        {
+            using type =
+                typename iterate_fold<S, std::make_index_sequence<N>>::type;
+        };
+        template <typename S>
+        struct iterate_block
+        {
+            using inner = S;
+            using next =
+                iterate_block<typename iterate<S, iterate_block_size>::type>;
+        };
+        template <typename S, std::size_t N>
+        struct iterate<S, N, false>
+        {
+            using type = typename iterate<
+                typename iterate<iterate_block<S>,
+                                 N / iterate_block_size>::type::inner,
+                N % iterate_block_size>::type;
+        };
+        /**
+         * @brief evaluate S::next until S::done is true
+         * @note Blocks of steps are doubled each time, so at most twice the
+         * steps needed are evaluated with O(log n) template depth. Finished
+         * states should be their own next.
+         */
+        template <typename S,
+                  std::size_t N = iterate_block_size,
+                  bool          = S::done>
+        struct iterate_until
+        {
+            using type =
+                typename iterate_until<typename iterate<S, N>::type,
+                                       N * 2>::type;
+        };
+        template <typename S, std::size_t N>
+        struct iterate_until<S, N, true>
+        {
+            using type = S;
+        };
+        /**
+         * @brief build a perfectly balanced tree from the first N elements of
+         * the sorted list L (sorted in descending order if Descending is true)
+         * @note rest is the list after the consumed elements
+         */
+        template <typename L, std::size_t N, bool Descending = false>
+        struct build_balanced
+        {
+        private:
+            using first_part = build_balanced<L,
+                                              Descending ? N - N / 2 - 1 :
+                                                           N / 2,
+                                              Descending>;
+            using root        = typename first_part::rest;
+            using second_part = build_balanced<typename root::tail,
+                                               Descending ? N / 2 :
+                                                            N - N / 2 - 1,
+                                               Descending>;
+            using left  = typename std::conditional_t<Descending,
+                                                      second_part,
+                                                      first_part>::type;
+            using right = typename std::conditional_t<Descending,
+                                                      first_part,
+                                                      second_part>::type;
+
+        public:
+            using type = tavl_node<left,
+                                   right,
+                                   (left::height > right::height ?
+                                        left::height + 1 :
+                                        right::height + 1),
+                                   typename root::head::key,
+                                   typename root::head::value>;
+            using rest = typename second_part::rest;
+        };
+        template <typename L, bool Descending>
+        struct build_balanced<L, 0, Descending>
+        {
+            using type = empty_node;
+            using rest = L;
+        };
+    } // namespace impl
+    /**
+     * @brief build a perfectly balanced tree from key-value pairs in one pass
+     * @tparam KVs kv_pairs (or anything with member types key && value)
+     * sorted by key in strictly ascending order
+     * @note O(n) node instantiations, O(log n) template depth and no
+     * rotations. The order of KVs is not checked.
+     */
+    template <typename... KVs>
+    struct tavl_from_sorted
+    {
         using type =
-            tavl_for_each_middle_order_t<T1, for_each_node, merger, empty_node>;
+            typename impl::build_balanced<impl::list_from_pack_t<KVs...>,
+                                          sizeof...(KVs)>::type;
+    };
+    /**
+     * @brief build a perfectly balanced tree from key-value pairs in one pass
+     * @tparam KVs kv_pairs sorted by key in strictly ascending order
+     */
+    template <typename... KVs>
+    using tavl_from_sorted_t = typename tavl_from_sorted<KVs...>::type;
+    /**
+     * @brief duplicate policy: the element shown first is kept
+     */
+    struct tavl_keep_first
+    {
+        template <typename First, typename Second>
+        using apply = First;
+    };
+    /**
+     * @brief duplicate policy: the element shown last is kept
+     */
+    struct tavl_keep_last
+    {
+        template <typename First, typename Second>
+        using apply = Second;
+    };
+    /**
+     * @brief duplicate policy: the key shown first is kept and its value is
+     * typename Func<first-value, second-value>::type
+     * @note values are combined in the input order, but not necessarily from
+     * left to right, so Func should be associative when a key is shown more
+     * than twice
+     */
+    template <template <typename, typename> typename Func>
+    struct tavl_merge_with
+    {
+        template <typename First, typename Second>
+        using apply =
+            kv_pair<typename First::key,
+                    typename Func<typename First::value,
+                                  typename Second::value>::type>;
+    };
+    namespace impl
+    {
+        // policy of tavl_sort: elements with the same key are all kept
+        struct keep_duplicates;
+        // 0: take the head of A, 1: take the head of B, 2: combine both
+        template <typename Policy, bool Ascending, int Order>
+        inline constexpr int merge_action =
+            Order == 0 ?
+                (std::is_same_v<Policy, keep_duplicates> ? (Ascending ? 1 : 0) :
+                                                           2) :
+                ((Order < 0) != Ascending ? 0 : 1);
+        template <typename A,
+                  typename B,
+                  typename Out,
+                  std::size_t Size,
+                  typename Policy,
+                  bool Ascending>
+        struct merge_state;
+        template <typename A,
+                  typename B,
+                  typename Out,
+                  std::size_t Size,
+                  typename Policy,
+                  bool Ascending,
+                  int Action>
+        struct merge_take
+        {
+            using type = merge_state<typename A::tail,
+                                     B,
+                                     list_cons<typename A::head, Out>,
+                                     Size + 1,
+                                     Policy,
+                                     Ascending>;
+        };
+        template <typename A,
+                  typename B,
+                  typename Out,
+                  std::size_t Size,
+                  typename Policy,
+                  bool Ascending>
+        struct merge_take<A, B, Out, Size, Policy, Ascending, 1>
+        {
+            using type = merge_state<A,
+                                     typename B::tail,
+                                     list_cons<typename B::head, Out>,
+                                     Size + 1,
+                                     Policy,
+                                     Ascending>;
+        };
+        template <typename A,
+                  typename B,
+                  typename Out,
+                  std::size_t Size,
+                  typename Policy,
+                  bool Ascending>
+        struct merge_take<A, B, Out, Size, Policy, Ascending, 2>
+        {
+            using type = merge_state<
+                typename A::tail,
+                typename B::tail,
+                list_cons<typename Policy::template apply<typename A::head,
+                                                          typename B::head>,
+                          Out>,
+                Size + 1,
+                Policy,
+                Ascending>;
+        };
+        /**
+         * @brief one step of merging sorted lists A (former elements) and B
+         * (latter elements) into Out by prepending.
+         * @note A and B are ascending if the result should be descending and
+         * vice versa.
+         */
+        template <typename A,
+                  typename B,
+                  typename Out,
+                  std::size_t Size,
+                  typename Policy,
+                  bool Ascending>
+        struct merge_state
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+            using next = typename merge_take<
+                A,
+                B,
+                Out,
+                Size,
+                Policy,
+                Ascending,
+                merge_action<Policy,
+                             Ascending,
+                             compare_v<typename A::head::key,
+                                       typename B::head::key>>>::type;
+        };
+        template <typename B,
+                  typename Out,
+                  std::size_t Size,
+                  typename Policy,
+                  bool Ascending>
+        struct merge_state<list_nil, B, Out, Size, Policy, Ascending>
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+            using next = typename merge_take<list_nil,
+                                             B,
+                                             Out,
+                                             Size,
+                                             Policy,
+                                             Ascending,
+                                             1>::type;
+        };
+        template <typename A,
+                  typename Out,
+                  std::size_t Size,
+                  typename Policy,
+                  bool Ascending>
+        struct merge_state<A, list_nil, Out, Size, Policy, Ascending>
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+            using next = typename merge_take<A,
+                                             list_nil,
+                                             Out,
+                                             Size,
+                                             Policy,
+                                             Ascending,
+                                             0>::type;
+        };
+        template <typename Out,
+                  std::size_t Size,
+                  typename Policy,
+                  bool Ascending>
+        struct merge_state<list_nil, list_nil, Out, Size, Policy, Ascending>
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+            using next = merge_state;
+        };
+        /**
+         * @brief stable merge sort of the first N elements of L
+         * @note Each level asks for the opposite order from the level below,
+         * so that merging by prepending never needs a reversal. Merges are
+         * driven by impl::iterate, leaving O(log n) template depth.
+         */
+        template <typename L, std::size_t N, typename Policy, bool Ascending>
+        struct sort_list
+        {
+        private:
+            using left_part = sort_list<L, N / 2, Policy, !Ascending>;
+            using right_part = sort_list<typename left_part::rest,
+                                         N - N / 2,
+                                         Policy,
+                                         !Ascending>;
+            using merged = typename iterate<
+                merge_state<typename left_part::type,
+                            typename right_part::type,
+                            list_nil,
+                            0,
+                            Policy,
+                            Ascending>,
+                left_part::size::value + right_part::size::value>::type;
+
+        public:
+            using type = typename merged::list;
+            using size = typename merged::size;
+            using rest = typename right_part::rest;
+        };
+        template <typename L, typename Policy, bool Ascending>
+        struct sort_list<L, 1, Policy, Ascending>
+        {
+            using type = list_cons<typename L::head, list_nil>;
+            using size = std::integral_constant<std::size_t, 1>;
+            using rest = typename L::tail;
+        };
+        template <typename L, typename Policy, bool Ascending>
+        struct sort_list<L, 0, Policy, Ascending>
+        {
+            using type = list_nil;
+            using size = std::integral_constant<std::size_t, 0>;
+            using rest = L;
+        };
+        template <typename Policy, typename... KVs>
+        using sort_pack =
+            sort_list<list_from_pack_t<KVs...>, sizeof...(KVs), Policy, true>;
+        template <typename L,
+                  typename Current,
+                  typename Out,
+                  std::size_t Size,
+                  typename Policy>
+        struct unique_state;
+        template <typename L,
+                  typename Current,
+                  typename Out,
+                  std::size_t Size,
+                  typename Policy,
+                  bool Same>
+        struct unique_take
+        {
+            using type = unique_state<typename L::tail,
+                                      typename L::head,
+                                      list_cons<Current, Out>,
+                                      Size + 1,
+                                      Policy>;
+        };
+        template <typename L,
+                  typename Current,
+                  typename Out,
+                  std::size_t Size,
+                  typename Policy>
+        struct unique_take<L, Current, Out, Size, Policy, true>
+        {
+            using type = unique_state<
+                typename L::tail,
+                typename Policy::template apply<Current, typename L::head>,
+                Out,
+                Size,
+                Policy>;
+        };
+        /**
+         * @brief one step of removing adjacent duplicates from L
+         * @note Current is the pending element (list_nil if none), the
+         * result is prepended to Out.
+         */
+        template <typename L,
+                  typename Current,
+                  typename Out,
+                  std::size_t Size,
+                  typename Policy>
+        struct unique_state
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+            using next = typename unique_take<
+                L,
+                Current,
+                Out,
+                Size,
+                Policy,
+                compare_v<typename Current::key, typename L::head::key> ==
+                    0>::type;
+        };
+        template <typename L, typename Out, std::size_t Size, typename Policy>
+        struct unique_state<L, list_nil, Out, Size, Policy>
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+            using next = unique_state<typename L::tail,
+                                      typename L::head,
+                                      Out,
+                                      Size,
+                                      Policy>;
+        };
+        template <typename Current,
+                  typename Out,
+                  std::size_t Size,
+                  typename Policy>
+        struct unique_state<list_nil, Current, Out, Size, Policy>
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+            using next = unique_state<list_nil,
+                                      list_nil,
+                                      list_cons<Current, Out>,
+                                      Size + 1,
+                                      Policy>;
+        };
+        template <typename Out, std::size_t Size, typename Policy>
+        struct unique_state<list_nil, list_nil, Out, Size, Policy>
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+            using next = unique_state;
+        };
+    } // namespace impl
+    /**
+     * @brief sort key-value pairs by key (stable, duplicates are kept)
+     * @tparam Pack a pack of kv_pairs, for example std::tuple<kv_pair...>.
+     * The result is the same template with sorted arguments.
+     * @note merge sort: O(n log n) comparisons and O(log n) template depth
+     */
+    template <typename Pack>
+    struct tavl_sort;
+    template <template <typename...> typename Pack, typename... KVs>
+    struct tavl_sort<Pack<KVs...>>
+    {
+    private:
+        using sorted = impl::sort_pack<impl::keep_duplicates, KVs...>;
+
+    public:
+        using type = typename impl::pack_rewrap<
+            typename impl::list_to_pack<typename sorted::type,
+                                        sorted::size::value>::type,
+            Pack>::type;
+    };
+    /**
+     * @brief sort key-value pairs by key (stable, duplicates are kept)
+     * @tparam Pack a pack of kv_pairs, for example std::tuple<kv_pair...>
+     */
+    template <typename Pack>
+    using tavl_sort_t = typename tavl_sort<Pack>::type;
+    /**
+     * @brief remove duplicated keys from a sorted pack of key-value pairs
+     * @tparam Pack a pack of kv_pairs sorted by key, for example
+     * std::tuple<kv_pair...>. The result is the same template.
+     * @tparam Policy tavl_keep_first, tavl_keep_last or tavl_merge_with<Func>
+     */
+    template <typename Pack, typename Policy = tavl_keep_first>
+    struct tavl_unique;
+    template <template <typename...> typename Pack,
+              typename... KVs,
+              typename Policy>
+    struct tavl_unique<Pack<KVs...>, Policy>
+    {
+    private:
+        using unique = typename impl::iterate<
+            impl::unique_state<impl::list_from_pack_t<KVs...>,
+                               impl::list_nil,
+                               impl::list_nil,
+                               0,
+                               Policy>,
+            sizeof...(KVs) + 1>::type;
+
+    public:
+        using type = typename impl::pack_rewrap<
+            typename impl::list_to_pack<typename unique::list,
+                                        unique::size::value,
+                                        true>::type,
+            Pack>::type;
+    };
+    /**
+     * @brief remove duplicated keys from a sorted pack of key-value pairs
+     * @tparam Pack a pack of kv_pairs sorted by key
+     * @tparam Policy tavl_keep_first, tavl_keep_last or tavl_merge_with<Func>
+     */
+    template <typename Pack, typename Policy = tavl_keep_first>
+    using tavl_unique_t = typename tavl_unique<Pack, Policy>::type;
+    /**
+     * @brief build a balanced tree from key-value pairs in any order
+     * @tparam Policy what to do with duplicated keys: tavl_keep_first,
+     * tavl_keep_last or tavl_merge_with<Func>
+     * @tparam KVs kv_pairs
+     * @note the pairs are merge sorted (duplicates are removed while
+     * merging), then the tree is built by tavl_from_sorted
+     */
+    template <typename Policy, typename... KVs>
+    struct tavl_from_unsorted_with
+    {
+    private:
+        using sorted = impl::sort_pack<Policy, KVs...>;
+
+    public:
+        using type = typename impl::build_balanced<typename sorted::type,
+                                                   sorted::size::value>::type;
+    };
+    /**
+     * @brief build a balanced tree from key-value pairs in any order
+     * @tparam Policy tavl_keep_first, tavl_keep_last or tavl_merge_with<Func>
+     * @tparam KVs kv_pairs
+     */
+    template <typename Policy, typename... KVs>
+    using tavl_from_unsorted_with_t =
+        typename tavl_from_unsorted_with<Policy, KVs...>::type;
+    /**
+     * @brief build a balanced tree from key-value pairs in any order, the
+     * first one wins if a key is shown more than once
+     * @tparam KVs kv_pairs
+     */
+    template <typename... KVs>
+    using tavl_from_unsorted = tavl_from_unsorted_with<tavl_keep_first, KVs...>;
+    /**
+     * @brief build a balanced tree from key-value pairs in any order, the
+     * first one wins if a key is shown more than once
+     * @tparam KVs kv_pairs
+     */
+    template <typename... KVs>
+    using tavl_from_unsorted_t = typename tavl_from_unsorted<KVs...>::type;
+    namespace impl
+    {
+        /**
+         * @brief prepend the elements of T to Tail in ascending order, so
+         * that the result lists them in descending order
+         * @note size is Size plus the number of elements in T
+         */
+        template <typename T, typename Tail = list_nil, std::size_t Size = 0>
+        struct flatten_desc
+        {
+        private:
+            using left_part = flatten_desc<typename T::left, Tail, Size>;
+            using right_part =
+                flatten_desc<typename T::right,
+                             list_cons<kv_pair<typename T::key,
+                                               typename T::value>,
+                                       typename left_part::type>,
+                             left_part::size::value + 1>;
+
+        public:
+            using type = typename right_part::type;
+            using size = typename right_part::size;
+        };
+        template <typename Tail, std::size_t Size>
+        struct flatten_desc<empty_node, Tail, Size>
+        {
+            using type = Tail;
+            using size = std::integral_constant<std::size_t, Size>;
+        };
+        /**
+         * @brief prepend the elements of T to Tail in descending order, so
+         * that the result lists them in ascending order
+         * @note size is Size plus the number of elements in T
+         */
+        template <typename T, typename Tail = list_nil, std::size_t Size = 0>
+        struct flatten_asc
+        {
+        private:
+            using right_part = flatten_asc<typename T::right, Tail, Size>;
+            using left_part =
+                flatten_asc<typename T::left,
+                            list_cons<kv_pair<typename T::key,
+                                              typename T::value>,
+                                      typename right_part::type>,
+                            right_part::size::value + 1>;
+
+        public:
+            using type = typename left_part::type;
+            using size = typename left_part::size;
+        };
+        template <typename Tail, std::size_t Size>
+        struct flatten_asc<empty_node, Tail, Size>
+        {
+            using type = Tail;
+            using size = std::integral_constant<std::size_t, Size>;
+        };
+        /**
+         * @brief list the elements of T in the given order
+         */
+        template <typename T, bool Ascending>
+        using flatten =
+            std::conditional_t<Ascending, flatten_asc<T>, flatten_desc<T>>;
+        /**
+         * @brief merge two trees in order and build a balanced tree from the
+         * result
+         * @tparam Policy how to combine elements with the same key, the
+         * element of T1 is passed first
+         * @note O(n + m) instantiations
+         */
+        template <typename Policy, typename T1, typename T2>
+        struct union_merge
+        {
+        private:
+            using lhs    = flatten_desc<T1>;
+            using rhs    = flatten_desc<T2>;
+            using merged = typename iterate<
+                merge_state<typename lhs::type,
+                            typename rhs::type,
+                            list_nil,
+                            0,
+                            Policy,
+                            true>,
+                lhs::size::value + rhs::size::value>::type;
+
+        public:
+            // keeping the first element of each key adds nothing to T1 if
+            // no key is new, so T1 is returned instead of a rebuilt tree
+            static constexpr bool changed =
+                !std::is_same_v<Policy, tavl_keep_first> ||
+                merged::size::value != lhs::size::value;
+            using type = typename std::conditional_t<
+                changed,
+                build_balanced<typename merged::list, merged::size::value>,
+                identity<T1>>::type;
+        };
+        template <typename Policy, typename T1>
+        struct union_merge<Policy, T1, empty_node>
+        {
+            using type                    = T1;
+            static constexpr bool changed = false;
+        };
+        template <typename Policy, typename T2>
+        struct union_merge<Policy, empty_node, T2>
+        {
+            using type                    = T2;
+            static constexpr bool changed = true;
+        };
+        template <typename Policy>
+        struct union_merge<Policy, empty_node, empty_node>
+        {
+            using type                    = empty_node;
+            static constexpr bool changed = false;
+        };
+        /**
+         * @brief combine the values of the same key in all trees given to
+         * tavl_intersect_with_func, Func is applied at the last tree
+         */
+        template <template <typename, typename...> typename Func,
+                  bool First,
+                  bool Last>
+        struct intersect_values
+        {
+            template <typename Key, typename Values>
+            struct apply_func;
+            template <typename Key, typename... Values>
+            struct apply_func<Key, type_pack<Values...>>
+            {
+                using type = typename Func<Key, Values...>::type;
+            };
+            template <typename A, typename B>
+            using values = typename pack_concat<
+                std::conditional_t<First,
+                                   type_pack<typename A::value>,
+                                   typename A::value>,
+                type_pack<typename B::value>>::type;
+            template <typename A, typename B>
+            using both = kv_pair<
+                typename A::key,
+                typename std::conditional_t<
+                    Last,
+                    apply_func<typename A::key, values<A, B>>,
+                    identity<values<A, B>>>::type>;
+        };
+        /**
+         * @brief operations for join_state
+         * @note keep_left: whether elements only shown in the former list are
+         * kept (as left<element>), keep_both: whether elements shown in both
+         * lists are kept (as both<former, latter>). Elements only shown in
+         * the latter list are always dropped.
+         */
+        template <bool KeepLeft,
+                  bool KeepBoth,
+                  template <typename>
+                  typename Left,
+                  template <typename, typename>
+                  typename Both>
+        struct join_op
+        {
+            static constexpr bool keep_left = KeepLeft;
+            static constexpr bool keep_both = KeepBoth;
+            template <typename A>
+            using left = Left<A>;
+            template <typename A, typename B>
+            using both = Both<A, B>;
+        };
+        template <typename A>
+        using join_keep_element = A;
+        template <typename A, typename B>
+        using join_keep_former = A;
+        using join_intersect =
+            join_op<false, true, join_keep_element, join_keep_former>;
+        using join_difference =
+            join_op<true, false, join_keep_element, join_keep_former>;
+        template <typename A,
+                  typename B,
+                  typename Out,
+                  std::size_t Size,
+                  typename Op,
+                  bool Ascending>
+        struct join_state;
+        template <typename Out, std::size_t Size, typename Op, bool Ascending>
+        using join_done =
+            join_state<list_nil, list_nil, Out, Size, Op, Ascending>;
+        template <bool Keep, typename Element, typename Out, std::size_t Size>
+        struct join_emit
+        {
+            using list = list_cons<Element, Out>;
+            using size = std::integral_constant<std::size_t, Size + 1>;
+        };
+        template <typename Element, typename Out, std::size_t Size>
+        struct join_emit<false, Element, Out, Size>
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+        };
+        template <typename A,
+                  typename B,
+                  typename Out,
+                  std::size_t Size,
+                  typename Op,
+                  bool Ascending,
+                  int Action>
+        struct join_take
+        {
+            // the head of A is not in B
+            using emit = join_emit<Op::keep_left,
+                                   typename Op::template left<typename A::head>,
+                                   Out,
+                                   Size>;
+            using type = join_state<typename A::tail,
+                                    B,
+                                    typename emit::list,
+                                    emit::size::value,
+                                    Op,
+                                    Ascending>;
+        };
+        template <typename A,
+                  typename B,
+                  typename Out,
+                  std::size_t Size,
+                  typename Op,
+                  bool Ascending>
+        struct join_take<A, B, Out, Size, Op, Ascending, 1>
+        {
+            // the head of B is not in A
+            using type =
+                join_state<A, typename B::tail, Out, Size, Op, Ascending>;
+        };
+        template <typename A,
+                  typename B,
+                  typename Out,
+                  std::size_t Size,
+                  typename Op,
+                  bool Ascending>
+        struct join_take<A, B, Out, Size, Op, Ascending, 2>
+        {
+            using emit = join_emit<
+                Op::keep_both,
+                typename Op::template both<typename A::head, typename B::head>,
+                Out,
+                Size>;
+            using type = join_state<typename A::tail,
+                                    typename B::tail,
+                                    typename emit::list,
+                                    emit::size::value,
+                                    Op,
+                                    Ascending>;
+        };
+        /**
+         * @brief one step of walking sorted lists A and B in lockstep and
+         * prepending the elements kept by Op to Out
+         * @note A and B are ascending if the result should be descending and
+         * vice versa. The walk stops as soon as nothing more can be kept.
+         */
+        template <typename A,
+                  typename B,
+                  typename Out,
+                  std::size_t Size,
+                  typename Op,
+                  bool Ascending>
+        struct join_state
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+            using next = typename join_take<
+                A,
+                B,
+                Out,
+                Size,
+                Op,
+                Ascending,
+                merge_action<void,
+                             Ascending,
+                             compare_v<typename A::head::key,
+                                       typename B::head::key>>>::type;
+        };
+        template <typename B,
+                  typename Out,
+                  std::size_t Size,
+                  typename Op,
+                  bool Ascending>
+        struct join_state<list_nil, B, Out, Size, Op, Ascending>
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+            using next = join_done<Out, Size, Op, Ascending>;
+        };
+        template <typename A,
+                  typename Out,
+                  std::size_t Size,
+                  typename Op,
+                  bool Ascending>
+        struct join_state<A, list_nil, Out, Size, Op, Ascending>
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+            using next = typename std::conditional_t<
+                Op::keep_left,
+                join_take<A, list_nil, Out, Size, Op, Ascending, 0>,
+                identity<join_done<Out, Size, Op, Ascending>>>::type;
+        };
+        template <typename Out, std::size_t Size, typename Op, bool Ascending>
+        struct join_state<list_nil, list_nil, Out, Size, Op, Ascending>
+        {
+            using list = Out;
+            using size = std::integral_constant<std::size_t, Size>;
+            using next = join_state;
+        };
+        /**
+         * @brief join the first N elements of L with every tree in Trees in
+         * turn
+         * @tparam Ops an operation for each tree
+         * @tparam Ascending the order of the next result, L is sorted in the
+         * opposite order
+         */
+        template <typename L,
+                  std::size_t N,
+                  bool Ascending,
+                  typename Ops,
+                  typename... Trees>
+        struct join_chain
+        {
+            // build the tree from the result
+            using type = typename build_balanced<L, N, Ascending>::type;
+        };
+        template <typename L,
+                  std::size_t N,
+                  bool Ascending,
+                  typename Op,
+                  typename... Ops,
+                  typename T,
+                  typename... Trees>
+        struct join_chain<L, N, Ascending, type_pack<Op, Ops...>, T, Trees...>
+        {
+        private:
+            using rhs    = flatten<T, !Ascending>;
+            using joined = typename iterate<
+                join_state<L,
+                           typename rhs::type,
+                           list_nil,
+                           0,
+                           Op,
+                           Ascending>,
+                N + rhs::size::value>::type;
+
+        public:
+            using type = typename join_chain<typename joined::list,
+                                             joined::size::value,
+                                             !Ascending,
+                                             type_pack<Ops...>,
+                                             Trees...>::type;
+        };
+        /**
+         * @brief join T1 with every tree in Trees in turn by lockstep walks,
+         * then build a balanced tree from the result
+         * @note O(n + m) instantiations for each tree
+         */
+        template <typename Ops, typename T1, typename... Trees>
+        struct join_trees
+        {
+        private:
+            using lhs = flatten_desc<T1>;
+
+        public:
+            using type = typename join_chain<typename lhs::type,
+                                             lhs::size::value,
+                                             true,
+                                             Ops,
+                                             Trees...>::type;
+        };
+        template <typename Op, typename>
+        using join_repeat = Op;
+        template <template <typename, typename...> typename Func, typename Seq>
+        struct intersect_ops;
+        template <template <typename, typename...> typename Func,
+                  std::size_t... Is>
+        struct intersect_ops<Func, std::index_sequence<Is...>>
+        {
+            using type = type_pack<join_op<
+                false,
+                true,
+                join_keep_element,
+                intersect_values<Func, Is == 0, Is + 1 == sizeof...(Is)>::
+                    template both>...>;
+        };
+        template <template <typename, typename...> typename Func,
+                  typename T1,
+                  typename... Trees>
+        struct intersect_with_func_impl
+        {
+            using type = typename join_trees<
+                typename intersect_ops<Func,
+                                       std::index_sequence_for<Trees...>>::type,
+                T1,
+                Trees...>::type;
+        };
+        // apply Func to every node if there is only one tree
+        template <template <typename, typename...> typename Func,
+                  typename L,
+                  typename R,
+                  int H,
+                  typename K,
+                  typename V>
+        struct intersect_with_func_impl<Func, tavl_node<L, R, H, K, V>>
+        {
+            using type =
+                tavl_node<typename intersect_with_func_impl<Func, L>::type,
+                          typename intersect_with_func_impl<Func, R>::type,
+                          H,
+                          K,
+                          typename Func<K, V>::type>;
+        };
+        template <template <typename, typename...> typename Func>
+        struct intersect_with_func_impl<Func, empty_node>
+        {
+            using type = empty_node;
+        };
+        template <template <typename, typename, typename> typename Func>
+        struct difference_values
+        {
+            template <typename A>
+            using left = kv_pair<
+                typename A::key,
+                typename Func<typename A::key, typename A::value, void>::type>;
+        };
+        template <typename S1, typename S2, bool Ascending>
+        struct subset_state;
+        struct subset_failed
+        {
+            static constexpr bool value = false;
+            using next                  = subset_failed;
+        };
+        template <typename S1, typename S2, bool Ascending, int Action>
+        struct subset_take
+        {
+            // the head of S1 is not in S2
+            using next = subset_failed;
+        };
+        template <typename S1, typename S2, bool Ascending>
+        struct subset_take<S1, S2, Ascending, 1>
+        {
+            using next = subset_state<S1, typename S2::tail, Ascending>;
+        };
+        template <typename S1, typename S2, bool Ascending>
+        struct subset_take<S1, S2, Ascending, 2>
+        {
+            using next =
+                subset_state<typename S1::tail, typename S2::tail, Ascending>;
+        };
+        /**
+         * @brief one step of checking whether every element of S1 is in S2
+         * @note S1 and S2 are descending if Ascending is true and vice versa.
+         * Only finished states (subset_failed, or S1 is empty) have a value.
+         */
+        template <typename S1, typename S2, bool Ascending>
+        struct subset_state
+        {
+            using next = typename subset_take<
+                S1,
+                S2,
+                Ascending,
+                merge_action<void,
+                             Ascending,
+                             compare_v<typename S1::head::key,
+                                       typename S2::head::key>>>::next;
+        };
+        template <typename S1, bool Ascending>
+        struct subset_state<S1, list_nil, Ascending>
+        {
+            using next = subset_failed;
+        };
+        template <typename S2, bool Ascending>
+        struct subset_state<list_nil, S2, Ascending>
+        {
+            static constexpr bool value = true;
+            using next                  = subset_state;
+        };
+        template <bool Ascending>
+        struct subset_state<list_nil, list_nil, Ascending>
+        {
+            static constexpr bool value = true;
+            using next                  = subset_state;
+        };
+    } // namespace impl
+    /**
+     * @brief create intersections between multiple trees
+     * @tparam T1 the first tree to examine
+     * @tparam Trees other trees
+     * @note Trees can be empty
+     * @note Elements of T1 are kept. The trees are walked in order in
+     * lockstep, which takes O(n + m) instantiations for each tree.
+     */
+    template <Node T1, Node... Trees>
+    struct tavl_intersect
+    {
+        using type = typename impl::join_trees<
+            impl::type_pack<impl::join_repeat<impl::join_intersect, Trees>...>,
+            T1,
+            Trees...>::type;
     };
     template <Node... Trees>
     struct tavl_intersect<empty_node, Trees...>
@@ -906,25 +2985,6 @@ namespace tavl
      */
     template <typename Tree, typename... Trees>
     using tavl_intersect_t = typename tavl_intersect<Tree, Trees...>::type;
-    namespace impl
-    {
-        template <typename Key, typename Value>
-        struct union_for_each_item_in_Tree
-        {
-            using type = type_pair<Key, Value>;
-        };
-        template <typename TreeBefore, typename Pair>
-        struct union_for_each_merger
-        {
-            using type = typename std::conditional_t<
-                tavl_contain_v<TreeBefore, typename Pair::first_type>,
-                identity<TreeBefore>,
-                lazy_template<tavl_insert_t,
-                              TreeBefore,
-                              typename Pair::first_type,
-                              typename Pair::second_type>>::type;
-        };
-    } // namespace impl
     /**
      * @brief computes the union of two sets
      * @tparam Tree the first tree to be computed
@@ -934,28 +2994,29 @@ namespace tavl
      * be used regardless of the value of those elements. See
      * tavl_union_with_func is another version that supports user defined
      * actions for conflicts between different trees
+     * @note Both trees are merged in order and the result is rebuilt as a
+     * balanced tree, which takes O(n + m) instantiations for each tree.
      */
     template <Node Tree, Node Tree2, Node... Others>
     struct tavl_union
     {
     private:
-        using union_result = tavl::tavl_for_each_middle_order_t<
-            Tree2,
-            impl::union_for_each_item_in_Tree,
-            impl::union_for_each_merger,
-            Tree>;
+        using union_result =
+            typename impl::union_merge<tavl_keep_first, Tree, Tree2>::type;
 
     public:
         using type = typename tavl_union<union_result, Others...>::type;
+        static constexpr bool changed = !std::is_same_v<type, Tree>;
     };
-    template <Node Tree, Node Tree2>
-    struct tavl_union<Tree, Tree2>
+    /**
+     * @brief computes the union of two sets
+     * @note If no key of Tree2 is new, type is Tree itself and changed is
+     * false.
+     */
+    template <Node Tree, Node Tree2>
+    struct tavl_union<Tree, Tree2>
+        : impl::union_merge<tavl_keep_first, Tree, Tree2>
     {
-        using type = tavl::tavl_for_each_middle_order_t<
-            Tree2,
-            impl::union_for_each_item_in_Tree,
-            impl::union_for_each_merger,
-            Tree>;
     };
     /**
      * @brief computes the union of two sets
@@ -985,41 +3046,2326 @@ namespace tavl
     using tavl_union_3 = tavl::tavl_union<T1, T2, T3>;
     namespace impl
     {
-        template <typename K, typename V>
-        struct tavl_size_node
+        template <typename Step, typename S, typename = void>
+        inline constexpr bool step_changed_v =
+            !std::is_same_v<typename Step::type, S>;
+        template <typename Step, typename S>
+        inline constexpr bool
+            step_changed_v<Step, S, std::void_t<decltype(Step::changed)>> =
+                Step::changed;
+        /**
+         * @brief state of tavl_fixpoint for iterate_until, Step<S> is
+         * instantiated once per state
+         */
+        template <template <typename S> typename Step, typename S>
+        struct fixpoint_state
+        {
+        private:
+            using step   = Step<S>;
+            using result = typename step::type;
+
+        public:
+            using type                 = S;
+            static constexpr bool done = !step_changed_v<step, S>;
+            using next                 = std::conditional_t<done,
+                                                fixpoint_state,
+                                                fixpoint_state<Step, result>>;
+        };
+    } // namespace impl
+    /**
+     * @brief apply Step to Init until it stops changing
+     * @tparam Step 'function' applied as Step<state>, which should have a
+     * member type named type (the next state). Its boolean member named
+     * changed is used to detect the fixed point if there is one, otherwise
+     * the next state is compared with the current one by std::is_same_v.
+     * @tparam Init initial state
+     * @note tavl_insert and tavl_union return the given tree itself and set
+     * changed to false if nothing is added, so steps built on them are
+     * cheap to check. Steps are driven by impl::iterate_until, so the
+     * template depth grows with the logarithm of the number of steps.
+     */
+    template <template <typename S> typename Step, typename Init>
+    struct tavl_fixpoint
+    {
+        using type =
+            typename impl::iterate_until<impl::fixpoint_state<Step, Init>,
+                                         1>::type::type;
+    };
+    template <template <typename S> typename Step, typename Init>
+    using tavl_fixpoint_t = typename tavl_fixpoint<Step, Init>::type;
+    /**
+     * @brief return the size of given tree T
+     * @tparam T tavl tree
+     * @note the size of a node is memoized, see tavl_node.
+     */
+    template <Node T>
+    struct tavl_size : std::integral_constant<std::size_t, T::size>
+    {
+    };
+    /**
+     * @brief return the size of given tree T
+     * @tparam T tavl tree
+     */
+    template <typename T>
+    inline constexpr std::size_t tavl_size_v = tavl_size<T>::value;
+    namespace impl
+    {
+        /**
+         * @brief -1 (1) if the I-th element is in the left (right) child of
+         * T, 0 if it is the root and 2 if T is empty.
+         */
+        template <typename T, std::size_t I>
+        inline constexpr int position_order_v =
+            is_empty_node_v<T> ?
+                2 :
+                I < T::left::size ? -1 : I == T::left::size ? 0 : 1;
+        template <typename T, std::size_t I, int = position_order_v<T, I>>
+        struct nth_impl
+        {
+            using type = typename nth_impl<typename T::left, I>::type;
+        };
+        template <typename T, std::size_t I>
+        struct nth_impl<T, I, 0>
+        {
+            using type = T;
+        };
+        template <typename T, std::size_t I>
+        struct nth_impl<T, I, 1>
+        {
+            using type = typename nth_impl<typename T::right,
+                                           I - T::left::size - 1>::type;
+        };
+        template <typename T, std::size_t I>
+        struct nth_impl<T, I, 2>
+        {
+            using type = empty_node;
+        };
+        template <typename T, typename K, int = key_order_v<K, T>>
+        struct rank_impl
+            : std::integral_constant<std::size_t,
+                                     rank_impl<typename T::left, K>::value>
+        {
+        };
+        template <typename T, typename K>
+        struct rank_impl<T, K, 0>
+            : std::integral_constant<std::size_t, T::left::size>
+        {
+        };
+        template <typename T, typename K>
+        struct rank_impl<T, K, 1>
+            : std::integral_constant<std::size_t,
+                                     T::left::size + 1 +
+                                         rank_impl<typename T::right, K>::value>
+        {
+        };
+        template <typename T, typename K>
+        struct rank_impl<T, K, 2> : std::integral_constant<std::size_t, 0>
+        {
+        };
+        /**
+         * @brief 1 (-1) if L is higher (lower) than R by more than 1, 0
+         * otherwise.
+         */
+        template <typename L, typename R>
+        inline constexpr int join_side_v =
+            L::height > R::height + 1 ? 1 : R::height > L::height + 1 ? -1 : 0;
+        /**
+         * @brief join L, (K, V) and R into a balanced tree, where all keys in L
+         * (R) are less (greater) than K
+         * @note the higher tree is descended along its inner spine until the
+         * heights meet, so only O(|L::height - R::height|) nodes are rebuilt.
+         */
+        template <typename L,
+                  typename R,
+                  typename K,
+                  typename V,
+                  int = join_side_v<L, R>>
+        struct join_node
+        {
+            using type = make_node_t<L, R, K, V>;
+        };
+        template <typename L, typename R, typename K, typename V>
+        struct join_node<L, R, K, V, 1>
+        {
+            using type = balance_t<
+                typename L::left,
+                typename join_node<typename L::right, R, K, V>::type,
+                typename L::key,
+                typename L::value>;
+        };
+        template <typename L, typename R, typename K, typename V>
+        struct join_node<L, R, K, V, -1>
+        {
+            using type =
+                balance_t<typename join_node<L, typename R::left, K, V>::type,
+                          typename R::right,
+                          typename R::key,
+                          typename R::value>;
+        };
+        template <typename L, typename R, typename K, typename V>
+        using join_node_t = typename join_node<L, R, K, V>::type;
+        /**
+         * @brief 0 if N covers no element of T, 2 if it covers all of them,
+         * -1 (1) if it ends in the left (right) child of T.
+         */
+        template <typename T, std::size_t N>
+        inline constexpr int cut_order_v =
+            N == 0 ? 0 :
+                     N >= T::size ? 2 : N <= T::left::size ? -1 : 1;
+        /**
+         * @brief the first N elements of T
+         */
+        template <typename T, std::size_t N, int = cut_order_v<T, N>>
+        struct take_front
+        {
+            using type = typename take_front<typename T::left, N>::type;
+        };
+        template <typename T, std::size_t N>
+        struct take_front<T, N, 1>
+        {
+            using type = join_node_t<
+                typename T::left,
+                typename take_front<typename T::right,
+                                    N - T::left::size - 1>::type,
+                typename T::key,
+                typename T::value>;
+        };
+        template <typename T, std::size_t N>
+        struct take_front<T, N, 0>
+        {
+            using type = empty_node;
+        };
+        template <typename T, std::size_t N>
+        struct take_front<T, N, 2>
+        {
+            using type = T;
+        };
+        /**
+         * @brief T without its first N elements
+         */
+        template <typename T, std::size_t N, int = cut_order_v<T, N>>
+        struct drop_front
+        {
+            using type = join_node_t<
+                typename drop_front<typename T::left, N>::type,
+                typename T::right,
+                typename T::key,
+                typename T::value>;
+        };
+        template <typename T, std::size_t N>
+        struct drop_front<T, N, 1>
+        {
+            using type = typename drop_front<typename T::right,
+                                             N - T::left::size - 1>::type;
+        };
+        template <typename T, std::size_t N>
+        struct drop_front<T, N, 0>
+        {
+            using type = T;
+        };
+        template <typename T, std::size_t N>
+        struct drop_front<T, N, 2>
+        {
+            using type = empty_node;
+        };
+    } // namespace impl
+    /**
+     * @brief get the I-th (0-based) element in the given AVL tree. Return the
+     * sub-tree with it as its root, empty_node if I is out of range.
+     * @tparam T AVL tree
+     * @tparam I position
+     */
+    template <Node T, std::size_t I>
+    using tavl_nth_t = typename impl::nth_impl<T, I>::type;
+    /**
+     * @brief the number of elements in T whose keys are less than K, i.e. the
+     * position of K in T if it is contained.
+     * @tparam T AVL tree
+     * @tparam K key type
+     */
+    template <Node T, KeyType K>
+    inline constexpr std::size_t tavl_rank_v = impl::rank_impl<T, K>::value;
+    /**
+     * @brief the balanced tree of the elements of T at the positions in
+     * [Begin, End), End is clamped to the size of T.
+     * @note O(log n) nodes are rebuilt; a prefix or suffix of T which already
+     * is a sub-tree of T is reused as it is.
+     */
+    template <Node T, std::size_t Begin, std::size_t End>
+    using tavl_slice_t = typename impl::take_front<
+        typename impl::drop_front<T, Begin>::type,
+        (End > Begin ? End - Begin : 0)>::type;
+    namespace impl
+    {
+#ifdef TAVL_HAS_TYPE_PACK_ELEMENT
+        template <std::size_t I, typename... Ts>
+        struct pack_element
+        {
+            using type = __type_pack_element<I, Ts...>;
+        };
+#else
+        template <std::size_t I, typename T>
+        struct pack_slot
+        {
+        };
+        template <typename Seq, typename... Ts>
+        struct pack_slots;
+        template <std::size_t... Is, typename... Ts>
+        struct pack_slots<std::index_sequence<Is...>, Ts...>
+            : pack_slot<Is, Ts>...
+        {
+        };
+        // the slot is picked by overload resolution, so indexing costs no
+        // nested instantiations once the slots of a pack are built
+        template <std::size_t I, typename T>
+        T pack_select(const pack_slot<I, T>&);
+        template <std::size_t I, typename... Ts>
+        struct pack_element
+        {
+            using type = decltype(pack_select<I>(
+                pack_slots<std::index_sequence_for<Ts...>, Ts...>{}));
+        };
+#endif
+    } // namespace impl
+    /**
+     * @brief read-only sorted sequence of key-value pairs. Lookups are binary
+     * searches over the pack, no tree is built.
+     * @tparam KVs kv_pairs (or anything with member types key && value)
+     * sorted by key in strictly ascending order
+     * @note the whole table is a single type whose arguments are the
+     * elements, so types do not nest as they do in tavl_node. See
+     * tavl_flatten and tavl_unflatten for conversions.
+     */
+    template <typename... KVs>
+    struct tavl_flat
+    {
+        static constexpr std::size_t size = sizeof...(KVs);
+        template <std::size_t I>
+        using element = typename impl::pack_element<I, KVs...>::type;
+    };
+    namespace impl
+    {
+        /**
+         * @brief ordinals of sorted keys, see key_ordinal
+         */
+        template <typename... Keys>
+        struct flat_ordinals
+        {
+            using ordinal_type = std::common_type_t<
+                std::decay_t<decltype(key_ordinal<Keys>::value)>...>;
+            static constexpr ordinal_type values[] = {
+                key_ordinal<Keys>::value...};
+        };
+        template <typename O, std::size_t N, typename Key>
+        constexpr std::size_t ordinal_lower_bound(const O (&values)[N],
+                                                  const Key& key)
+        {
+            std::size_t lo = 0;
+            std::size_t hi = N;
+            while (lo < hi)
+            {
+                std::size_t mid = lo + (hi - lo) / 2;
+                if (values[mid] < key)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+        template <typename F, typename K>
+        inline constexpr bool flat_use_ordinals_v = false;
+        template <typename... KVs, typename K>
+        inline constexpr bool flat_use_ordinals_v<tavl_flat<KVs...>, K> =
+            sizeof...(KVs) != 0 && has_key_ordinal_v<K> &&
+            (has_key_ordinal_v<typename KVs::key> && ...);
+        /**
+         * @brief order of K against the middle key of [Lo, Hi) in F, or 2 if
+         * the range is empty.
+         */
+        template <typename F, typename K, std::size_t Lo, std::size_t Hi>
+        inline constexpr int flat_order_v =
+            compare_v<K,
+                      typename F::template element<(Lo + Hi) / 2>::key>;
+        template <typename F, typename K, std::size_t I>
+        inline constexpr int flat_order_v<F, K, I, I> = 2;
+        /**
+         * @brief binary search of K in [Lo, Hi) of F, the template depth is
+         * O(log n)
+         * @note rank is the number of keys less than K
+         */
+        template <typename F,
+                  typename K,
+                  std::size_t Lo,
+                  std::size_t Hi,
+                  int = flat_order_v<F, K, Lo, Hi>>
+        struct flat_bisect : flat_bisect<F, K, Lo, (Lo + Hi) / 2>
+        {
+        };
+        template <typename F, typename K, std::size_t Lo, std::size_t Hi>
+        struct flat_bisect<F, K, Lo, Hi, 1>
+            : flat_bisect<F, K, (Lo + Hi) / 2 + 1, Hi>
+        {
+        };
+        template <typename F, typename K, std::size_t Lo, std::size_t Hi>
+        struct flat_bisect<F, K, Lo, Hi, 0>
+        {
+            static constexpr std::size_t rank  = (Lo + Hi) / 2;
+            static constexpr bool        found = true;
+        };
+        template <typename F, typename K, std::size_t Lo, std::size_t Hi>
+        struct flat_bisect<F, K, Lo, Hi, 2>
+        {
+            static constexpr std::size_t rank  = Lo;
+            static constexpr bool        found = false;
+        };
+        template <typename F, typename K, bool = flat_use_ordinals_v<F, K>>
+        struct flat_search : flat_bisect<F, K, 0, F::size>
+        {
+        };
+        // keys with ordinals are searched by a single constexpr evaluation
+        template <typename... KVs, typename K>
+        struct flat_search<tavl_flat<KVs...>, K, true>
+        {
+        private:
+            using ordinals = flat_ordinals<typename KVs::key...>;
+
+        public:
+            static constexpr std::size_t rank =
+                ordinal_lower_bound(ordinals::values, key_ordinal<K>::value);
+            static constexpr bool found =
+                rank != sizeof...(KVs) &&
+                !(key_ordinal<K>::value < ordinals::values[rank]);
+        };
+        template <typename F, std::size_t I, bool = (I < F::size)>
+        struct flat_nth
         {
-            using type = std::integral_constant<std::size_t, 1>;
+            using type = typename F::template element<I>;
+        };
+        template <typename F, std::size_t I>
+        struct flat_nth<F, I, false>
+        {
+            using type = empty_node;
+        };
+        template <typename F, typename K>
+        struct flat_find
+        {
+        private:
+            using search = flat_search<F, K>;
+
+        public:
+            using type = typename flat_nth<F,
+                                           search::found ? search::rank :
+                                                           F::size>::type;
+        };
+    } // namespace impl
+    /**
+     * @brief get the I-th (0-based) element of the flat table F, empty_node
+     * if I is out of range.
+     */
+    template <typename F, std::size_t I>
+    using tavl_flat_nth_t = typename impl::flat_nth<F, I>::type;
+    /**
+     * @brief find the element of the flat table F whose key is K. Return the
+     * element, empty_node otherwise.
+     * @note if K and all keys of F have ordinals, the lookup is a constexpr
+     * binary search over the ordinals, otherwise it is a binary search with
+     * compare in O(log n) template depth.
+     */
+    template <typename F, KeyType K>
+    using tavl_flat_find_t = typename impl::flat_find<F, K>::type;
+    /**
+     * @brief check whether there is an element whose key is K in the flat
+     * table F
+     */
+    template <typename F, KeyType K>
+    inline constexpr bool tavl_flat_contain_v =
+        impl::flat_search<F, K>::found;
+    /**
+     * @brief the number of elements in the flat table F whose keys are less
+     * than K
+     */
+    template <typename F, KeyType K>
+    inline constexpr std::size_t tavl_flat_rank_v =
+        impl::flat_search<F, K>::rank;
+    namespace impl
+    {
+        template <typename Left, typename KV, typename Right>
+        struct to_pack_join;
+        template <typename... As, typename KV, typename... Bs>
+        struct to_pack_join<type_pack<As...>, KV, type_pack<Bs...>>
+        {
+            using type = type_pack<As..., KV, Bs...>;
+        };
+        /**
+         * @brief the elements of T in the middle order as a type_pack
+         * @note the packs of both children are joined at each node, so the
+         * template depth is bounded by the height of T.
+         */
+        template <typename T>
+        struct to_pack
+        {
+            using type = typename to_pack_join<
+                typename to_pack<typename T::left>::type,
+                kv_pair<typename T::key, typename T::value>,
+                typename to_pack<typename T::right>::type>::type;
+        };
+        template <>
+        struct to_pack<empty_node>
+        {
+            using type = type_pack<>;
+        };
+    } // namespace impl
+    /**
+     * @brief convert the AVL tree T to a flat table
+     * @note O(n) instantiations
+     */
+    template <Node T>
+    struct tavl_flatten
+    {
+        using type =
+            typename impl::pack_rewrap<typename impl::to_pack<T>::type,
+                                       tavl_flat>::type;
+    };
+    template <typename T>
+    using tavl_flatten_t = typename tavl_flatten<T>::type;
+    /**
+     * @brief build a perfectly balanced AVL tree from the flat table F, see
+     * tavl_from_sorted
+     */
+    template <typename F>
+    struct tavl_unflatten;
+    template <typename... KVs>
+    struct tavl_unflatten<tavl_flat<KVs...>> : tavl_from_sorted<KVs...>
+    {
+    };
+    template <typename F>
+    using tavl_unflatten_t = typename tavl_unflatten<F>::type;
+    namespace impl
+    {
+        /**
+         * @brief left fold over the elements of T in the middle order
+         * @note the state of the left child is passed to the right one as a
+         * template argument, so the template depth is bounded by the height
+         * of T.
+         */
+        template <typename T,
+                  template <typename S, typename K, typename V>
+                  typename F,
+                  typename S>
+        struct fold_impl
+        {
+            using type = typename fold_impl<
+                typename T::right,
+                F,
+                typename F<typename fold_impl<typename T::left, F, S>::type,
+                           typename T::key,
+                           typename T::value>::type>::type;
+        };
+        template <template <typename S, typename K, typename V> typename F,
+                  typename S>
+        struct fold_impl<empty_node, F, S>
+        {
+            using type = S;
+        };
+        template <typename Pack,
+                  template <typename K, typename V>
+                  typename F,
+                  template <typename...>
+                  typename To>
+        struct transform_pack;
+        template <typename... KVs,
+                  template <typename K, typename V>
+                  typename F,
+                  template <typename...>
+                  typename To>
+        struct transform_pack<type_pack<KVs...>, F, To>
+        {
+            using type =
+                To<typename F<typename KVs::key, typename KVs::value>::type...>;
+        };
+    } // namespace impl
+    /**
+     * @brief the elements of T in the middle order as kv_pairs in Pack, e.g.
+     * tavl_to_pack_t<T, std::tuple>
+     * @note O(n) instantiations with template depth bounded by the height of
+     * T
+     */
+    template <Node T, template <typename...> typename Pack>
+    using tavl_to_pack_t =
+        typename impl::pack_rewrap<typename impl::to_pack<T>::type, Pack>::type;
+    /**
+     * @brief fold the elements of T in the middle order with F, see
+     * tavl_for_each_middle_order
+     * @tparam F 'function' applied as F<state, key, value>, which should have
+     * a member type named type (the next state)
+     * @tparam Init initial state
+     * @note O(n) instantiations with template depth bounded by the height of
+     * T
+     */
+    template <Node T,
+              template <typename S, typename K, typename V>
+              typename F,
+              typename Init>
+    struct tavl_fold
+    {
+        using type = typename impl::fold_impl<T, F, Init>::type;
+    };
+    template <typename T,
+              template <typename S, typename K, typename V>
+              typename F,
+              typename Init>
+    using tavl_fold_t = typename tavl_fold<T, F, Init>::type;
+    /**
+     * @brief Pack<F<key, value>::type...> for the elements of T in the middle
+     * order
+     * @note a single pack expansion over tavl_to_pack_t
+     */
+    template <Node T,
+              template <typename K, typename V>
+              typename F,
+              template <typename...>
+              typename Pack>
+    using tavl_transform_to_pack_t =
+        typename impl::transform_pack<typename impl::to_pack<T>::type,
+                                      F,
+                                      Pack>::type;
+    namespace impl
+    {
+        /**
+         * @brief rebuild T node for node with the value (Keys = false) or the
+         * key (Keys = true) of each node replaced by F<key, value>::type
+         */
+        template <typename T,
+                  template <typename K, typename V>
+                  typename F,
+                  bool Keys>
+        struct transform_node
+        {
+        private:
+            using result = typename F<typename T::key, typename T::value>::type;
+
+        public:
+            using type = tavl_node<
+                typename transform_node<typename T::left, F, Keys>::type,
+                typename transform_node<typename T::right, F, Keys>::type,
+                T::height,
+                std::conditional_t<Keys, result, typename T::key>,
+                std::conditional_t<Keys, typename T::value, result>>;
+        };
+        template <template <typename K, typename V> typename F, bool Keys>
+        struct transform_node<empty_node, F, Keys>
+        {
+            using type = empty_node;
+        };
+    } // namespace impl
+    /**
+     * @brief replace the value of each element of T with F<key, value>::type
+     * @note The shape of T is kept, so it costs O(n) instantiations without
+     * any comparison or rotation.
+     */
+    template <Node T, template <typename K, typename V> typename F>
+    using tavl_transform_values_t =
+        typename impl::transform_node<T, F, false>::type;
+    /**
+     * @brief replace the key of each element of T with F<key, value>::type
+     * @note F must be strictly increasing, i.e. it must keep the order of the
+     * keys. It is not checked: the shape of T is kept as it is, which costs
+     * O(n) instantiations without any comparison or rotation.
+     */
+    template <Node T, template <typename K, typename V> typename F>
+    using tavl_transform_keys_monotone_t =
+        typename impl::transform_node<T, F, true>::type;
+    namespace impl
+    {
+        /**
+         * @brief join L and R, where keys of L are less than keys of R
+         */
+        template <typename L, typename R>
+        struct concat
+        {
+        private:
+            using successor = extract_min<R>;
+
+        public:
+            using type = join_node_t<L,
+                                     typename successor::rest,
+                                     typename successor::min::key,
+                                     typename successor::min::value>;
+        };
+        template <typename L>
+        struct concat<L, empty_node>
+        {
+            using type = L;
+        };
+        template <typename R>
+        struct concat<empty_node, R>
+        {
+            using type = R;
+        };
+        template <>
+        struct concat<empty_node, empty_node>
+        {
+            using type = empty_node;
+        };
+        template <typename L, typename R>
+        using concat_t = typename concat<L, R>::type;
+        /**
+         * @brief build a perfectly balanced tree from the elements of the
+         * flat table F in [Lo, Hi), the same shape as tavl_from_sorted
+         */
+        template <typename F,
+                  std::size_t Lo,
+                  std::size_t Hi,
+                  bool = (Lo == Hi)>
+        struct flat_build
+        {
+        private:
+            static constexpr std::size_t mid = Lo + (Hi - Lo) / 2;
+            using left  = typename flat_build<F, Lo, mid>::type;
+            using right = typename flat_build<F, mid + 1, Hi>::type;
+            using root  = typename F::template element<mid>;
+
+        public:
+            using type = make_node_t<left,
+                                     right,
+                                     typename root::key,
+                                     typename root::value>;
+        };
+        template <typename F, std::size_t Lo, std::size_t Hi>
+        struct flat_build<F, Lo, Hi, true>
+        {
+            using type = empty_node;
+        };
+        template <typename... KVs>
+        struct sorted_batch
+        {
+        private:
+            using sorted = sort_pack<tavl_keep_first, KVs...>;
+
+        public:
+            using type = typename pack_rewrap<
+                typename list_to_pack<typename sorted::type,
+                                      sorted::size::value>::type,
+                tavl_flat>::type;
+        };
+        /**
+         * @brief 0 if [Lo, Hi) of the batch is empty, 1 if T is empty,
+         * otherwise 2
+         */
+        template <typename T, std::size_t Lo, std::size_t Hi>
+        inline constexpr int batch_action_v =
+            Lo == Hi ? 0 : is_empty_node_v<T> ? 1 : 2;
+        /**
+         * @brief insert the elements of the sorted batch F in [Lo, Hi) into
+         * T. The batch is split by the key of each node, so a node is only
+         * visited if some element of the batch goes into its sub-tree.
+         */
+        template <typename T,
+                  typename F,
+                  std::size_t Lo,
+                  std::size_t Hi,
+                  int = batch_action_v<T, Lo, Hi>>
+        struct insert_many
+        {
+            using type = T;
+        };
+        template <typename T, typename F, std::size_t Lo, std::size_t Hi>
+        struct insert_many<T, F, Lo, Hi, 1> : flat_build<F, Lo, Hi>
+        {
+        };
+        template <typename T, typename F, std::size_t Lo, std::size_t Hi>
+        struct insert_many<T, F, Lo, Hi, 2>
+        {
+        private:
+            using split = flat_bisect<F, typename T::key, Lo, Hi>;
+            using left =
+                typename insert_many<typename T::left, F, Lo, split::rank>::
+                    type;
+            using right = typename insert_many<typename T::right,
+                                               F,
+                                               split::rank + split::found,
+                                               Hi>::type;
+
+        public:
+            using type =
+                join_node_t<left, right, typename T::key, typename T::value>;
+        };
+        /**
+         * @brief remove the keys of the sorted batch F in [Lo, Hi) from T,
+         * see insert_many
+         */
+        template <typename T,
+                  typename F,
+                  std::size_t Lo,
+                  std::size_t Hi,
+                  int = batch_action_v<T, Lo, Hi>>
+        struct remove_many
+        {
+            using type = T;
         };
-        template <typename L, typename R, typename C>
-        struct tavl_size_merger
+        template <typename T, typename F, std::size_t Lo, std::size_t Hi>
+        struct remove_many<T, F, Lo, Hi, 2>
+        {
+        private:
+            using split = flat_bisect<F, typename T::key, Lo, Hi>;
+            using left =
+                typename remove_many<typename T::left, F, Lo, split::rank>::
+                    type;
+            using right = typename remove_many<typename T::right,
+                                               F,
+                                               split::rank + split::found,
+                                               Hi>::type;
+
+        public:
+            using type = typename std::conditional_t<
+                split::found,
+                concat<left, right>,
+                join_node<left, right, typename T::key, typename T::value>>::
+                type;
+        };
+    } // namespace impl
+    /**
+     * @brief insert key-value pairs into the AVL tree T in one top-down pass
+     * @tparam KVs kv_pairs in any order. The first one wins if a key is
+     * shown more than once, and elements already in T are kept as they are.
+     * @note the batch is sorted once, then split by the key of each node on
+     * the way down, and sub-trees are joined on the way back. O(m log(n / m
+     * + 1)) nodes are visited and no intermediate tree is built per key.
+     */
+    template <Node T, typename... KVs>
+    struct tavl_insert_many
+    {
+    private:
+        using batch = typename impl::sorted_batch<KVs...>::type;
+
+    public:
+        using type = typename impl::insert_many<T, batch, 0, batch::size>::type;
+    };
+    template <typename T, typename... KVs>
+    using tavl_insert_many_t = typename tavl_insert_many<T, KVs...>::type;
+    /**
+     * @brief remove elements whose keys are Ks from the AVL tree T in one
+     * top-down pass, see tavl_insert_many
+     * @note keys which are not in T are ignored.
+     */
+    template <Node T, KeyType... Ks>
+    struct tavl_remove_many
+    {
+    private:
+        using batch = typename impl::sorted_batch<kv_pair<Ks>...>::type;
+
+    public:
+        using type = typename impl::remove_many<T, batch, 0, batch::size>::type;
+    };
+    template <typename T, typename... Ks>
+    using tavl_remove_many_t = typename tavl_remove_many<T, Ks...>::type;
+    namespace impl
+    {
+        template <typename T, typename K>
+        struct contain_lazy : std::bool_constant<tavl_contain_v<T, K>>
+        {
+        };
+    } // namespace impl
+    /**
+     * @brief look up the keys Ks in T. Return Pack<R...>, where each R is the
+     * result of tavl_find_t for the key at the same position of Ks.
+     * @tparam T AVL tree
+     * @tparam Pack template to hold the results, e.g. std::tuple
+     * @tparam Ks keys to look up, in any order and possibly repeated
+     * @note Each key is looked up on its own: the compare instantiations on
+     * the path of a key are specific to that key, so a shared descent would
+     * not save any of them, and splitting the batch at each node costs more
+     * than the lookups. Repeated keys are looked up once.
+     */
+    template <Node T, template <typename...> typename Pack, KeyType... Ks>
+    using tavl_find_many_t = Pack<tavl_find_t<T, Ks>...>;
+    /**
+     * @brief check whether all keys Ks are in T
+     * @note the keys are checked in order and no key after the first missing
+     * one is looked up
+     */
+    template <Node T, KeyType... Ks>
+    inline constexpr bool tavl_contains_all_v =
+        std::conjunction_v<impl::contain_lazy<T, Ks>...>;
+    /**
+     * @brief check whether any of the keys Ks is in T
+     * @note the keys are checked in order and no key after the first found
+     * one is looked up
+     */
+    template <Node T, KeyType... Ks>
+    inline constexpr bool tavl_contains_any_v =
+        std::disjunction_v<impl::contain_lazy<T, Ks>...>;
+    /**
+     * @brief join L, (K, V) and R into a balanced AVL tree
+     * @tparam L AVL tree whose keys are less than K
+     * @tparam R AVL tree whose keys are greater than K
+     * @note O(|L::height - R::height|) instantiations
+     */
+    template <Node L, KeyType K, typename V, Node R>
+    using tavl_join_t = impl::join_node_t<L, R, K, V>;
+    /**
+     * @brief concatenate the AVL trees L and R, where keys of L are less than
+     * keys of R
+     * @note O(log n) instantiations: the minimum of R is extracted and used
+     * to join L and the rest of R.
+     */
+    template <Node L, Node R>
+    using tavl_concat_t = impl::concat_t<L, R>;
+    namespace impl
+    {
+        template <typename T, typename K, int = key_order_v<K, T>>
+        struct split
+        {
+        private:
+            using part = split<typename T::left, K>;
+
+        public:
+            using less    = typename part::less;
+            using found   = typename part::found;
+            using greater = join_node_t<typename part::greater,
+                                        typename T::right,
+                                        typename T::key,
+                                        typename T::value>;
+        };
+        template <typename T, typename K>
+        struct split<T, K, 1>
+        {
+        private:
+            using part = split<typename T::right, K>;
+
+        public:
+            using less    = join_node_t<typename T::left,
+                                        typename part::less,
+                                        typename T::key,
+                                        typename T::value>;
+            using found   = typename part::found;
+            using greater = typename part::greater;
+        };
+        template <typename T, typename K>
+        struct split<T, K, 0>
+        {
+            using less    = typename T::left;
+            using found   = tavl_node<empty_node,
+                                      empty_node,
+                                      0,
+                                      typename T::key,
+                                      typename T::value>;
+            using greater = typename T::right;
+        };
+        template <typename T, typename K>
+        struct split<T, K, 2>
+        {
+            using less    = empty_node;
+            using found   = empty_node;
+            using greater = empty_node;
+        };
+    } // namespace impl
+    /**
+     * @brief split the AVL tree T by the key K
+     * @note less (greater) is the balanced AVL tree of elements whose keys
+     * are less (greater) than K, found is the element whose key is K as a
+     * kv_pair, empty_node if there is no such element. Sub-trees are joined
+     * on the way back from the single descent, so it costs O(log n)
+     * instantiations.
+     */
+    template <Node T, KeyType K>
+    struct tavl_split : impl::split<T, K>
+    {
+    };
+    namespace impl
+    {
+        /**
+         * @brief the sub-tree rooted at the first element of T whose key is
+         * not less than K (Strict = false) or greater than K (Strict = true)
+         */
+        template <typename T,
+                  typename K,
+                  bool Strict,
+                  int = key_order_v<K, T>>
+        struct bound_impl
+        {
+        private:
+            using sub = typename bound_impl<typename T::left, K, Strict>::type;
+
+        public:
+            using type =
+                std::conditional_t<std::is_same_v<sub, empty_node>, T, sub>;
+        };
+        template <typename T, typename K, bool Strict>
+        struct bound_impl<T, K, Strict, 1>
+        {
+            using type =
+                typename bound_impl<typename T::right, K, Strict>::type;
+        };
+        template <typename T, typename K>
+        struct bound_impl<T, K, false, 0>
+        {
+            using type = T;
+        };
+        template <typename T, typename K>
+        struct bound_impl<T, K, true, 0>
+        {
+            using type = tavl_min_t<typename T::right>;
+        };
+        template <typename T, typename K, bool Strict>
+        struct bound_impl<T, K, Strict, 2>
+        {
+            using type = empty_node;
+        };
+    } // namespace impl
+    /**
+     * @brief the first element of T whose key is not less than K. Return the
+     * sub-tree with it as its root, empty_node if there is no such element.
+     * @tparam T AVL tree
+     * @tparam K key type
+     */
+    template <Node T, KeyType K>
+    using tavl_lower_bound_t = typename impl::bound_impl<T, K, false>::type;
+    /**
+     * @brief the first element of T whose key is greater than K. Return the
+     * sub-tree with it as its root, empty_node if there is no such element.
+     * @tparam T AVL tree
+     * @tparam K key type
+     */
+    template <Node T, KeyType K>
+    using tavl_upper_bound_t = typename impl::bound_impl<T, K, true>::type;
+    /**
+     * @brief the number of elements of T whose keys are in [Lo, Hi)
+     * @note two descents of T, no node is built
+     */
+    template <Node T, KeyType Lo, KeyType Hi>
+    inline constexpr std::size_t tavl_range_count_v =
+        tavl_rank_v<T, Hi> > tavl_rank_v<T, Lo> ?
+            tavl_rank_v<T, Hi> - tavl_rank_v<T, Lo> :
+            0;
+    /**
+     * @brief the balanced AVL tree of the elements of T whose keys are in
+     * [Lo, Hi)
+     * @note the range is turned into positions with tavl_rank_v and cut with
+     * tavl_slice_t, so O(log n) nodes are rebuilt and the sub-trees inside
+     * the range are reused.
+     */
+    template <Node T, KeyType Lo, KeyType Hi>
+    using tavl_range_t =
+        tavl_slice_t<T, tavl_rank_v<T, Lo>, tavl_rank_v<T, Hi>>;
+    /**
+     * @brief the elements of T whose keys are in [Lo, Hi) as a tavl_flat
+     */
+    template <Node T, KeyType Lo, KeyType Hi>
+    using tavl_range_flat_t = tavl_flatten_t<tavl_range_t<T, Lo, Hi>>;
+    namespace impl
+    {
+        /**
+         * @brief 1 if the root of T satisfies Pred, 0 if it does not, or 2
+         * if T is empty
+         */
+        template <typename T, template <typename K, typename V> typename Pred>
+        inline constexpr int pred_order_v =
+            Pred<typename T::key, typename T::value>::value ? 1 : 0;
+        template <template <typename K, typename V> typename Pred>
+        inline constexpr int pred_order_v<empty_node, Pred> = 2;
+        /**
+         * @brief split T into the elements satisfying Pred (matched) and the
+         * others (unmatched)
+         * @note Both halves are rebuilt by joining the results of the
+         * children, which costs O(n) instantiations in total. A sub-tree
+         * whose elements all satisfy Pred is rebuilt as itself.
+         */
+        template <typename T,
+                  template <typename K, typename V>
+                  typename Pred,
+                  int = pred_order_v<T, Pred>>
+        struct partition
+        {
+        private:
+            using left  = partition<typename T::left, Pred>;
+            using right = partition<typename T::right, Pred>;
+
+        public:
+            using matched   = join_node_t<typename left::matched,
+                                          typename right::matched,
+                                          typename T::key,
+                                          typename T::value>;
+            using unmatched = concat_t<typename left::unmatched,
+                                       typename right::unmatched>;
+        };
+        template <typename T,
+                  template <typename K, typename V>
+                  typename Pred>
+        struct partition<T, Pred, 0>
+        {
+        private:
+            using left  = partition<typename T::left, Pred>;
+            using right = partition<typename T::right, Pred>;
+
+        public:
+            using matched   = concat_t<typename left::matched,
+                                       typename right::matched>;
+            using unmatched = join_node_t<typename left::unmatched,
+                                          typename right::unmatched,
+                                          typename T::key,
+                                          typename T::value>;
+        };
+        template <typename T,
+                  template <typename K, typename V>
+                  typename Pred>
+        struct partition<T, Pred, 2>
+        {
+            using matched   = empty_node;
+            using unmatched = empty_node;
+        };
+        template <typename T,
+                  template <typename K, typename V>
+                  typename Pred,
+                  int = pred_order_v<T, Pred>>
+        struct filter
+        {
+            using type = join_node_t<
+                typename filter<typename T::left, Pred>::type,
+                typename filter<typename T::right, Pred>::type,
+                typename T::key,
+                typename T::value>;
+        };
+        template <typename T,
+                  template <typename K, typename V>
+                  typename Pred>
+        struct filter<T, Pred, 0>
+        {
+            using type =
+                concat_t<typename filter<typename T::left, Pred>::type,
+                         typename filter<typename T::right, Pred>::type>;
+        };
+        template <typename T,
+                  template <typename K, typename V>
+                  typename Pred>
+        struct filter<T, Pred, 2>
+        {
+            using type = empty_node;
+        };
+    } // namespace impl
+    /**
+     * @brief the balanced AVL tree of the elements of T whose Pred<key,
+     * value>::value is true
+     * @note O(n) instantiations, T itself is returned if all elements
+     * satisfy Pred.
+     */
+    template <Node T, template <typename K, typename V> typename Pred>
+    using tavl_filter_t = typename impl::filter<T, Pred>::type;
+    /**
+     * @brief split T by Pred<key, value>::value into two balanced AVL trees,
+     * matched and unmatched
+     * @note O(n) instantiations and Pred is instantiated once per element,
+     * see tavl_filter_t
+     */
+    template <Node T, template <typename K, typename V> typename Pred>
+    struct tavl_partition : impl::partition<T, Pred>
+    {
+    };
+    namespace impl
+    {
+        template <typename Pack>
+        inline constexpr std::size_t pack_size_v = 0;
+        template <typename... Ts>
+        inline constexpr std::size_t pack_size_v<type_pack<Ts...>> =
+            sizeof...(Ts);
+        /**
+         * @brief move the first N elements of Back to the end of Front
+         * @note nodes of tavl_btree hold a few elements, so peeling one
+         * element per instantiation is cheaper than indexing with
+         * pack_element, which costs an overload resolution per element
+         */
+        template <std::size_t N,
+                  typename Front,
+                  typename Back,
+                  bool = (N == 0)>
+        struct pack_split
+        {
+            using front = Front;
+            using back  = Back;
+        };
+        template <std::size_t N, typename... As, typename B, typename... Bs>
+        struct pack_split<N, type_pack<As...>, type_pack<B, Bs...>, false>
+            : pack_split<N - 1, type_pack<As..., B>, type_pack<Bs...>>
+        {
+        };
+#ifdef TAVL_HAS_TYPE_PACK_ELEMENT
+        template <typename Pack, std::size_t I>
+        struct pack_at;
+        template <typename... Ts, std::size_t I>
+        struct pack_at<type_pack<Ts...>, I>
+        {
+            using type = __type_pack_element<I, Ts...>;
+        };
+        template <typename Pack, std::size_t I>
+        using pack_at_t = typename pack_at<Pack, I>::type;
+#else
+        template <typename Pack>
+        struct pack_head;
+        template <typename T, typename... Ts>
+        struct pack_head<type_pack<T, Ts...>>
+        {
+            using type = T;
+        };
+        template <typename Pack, std::size_t I>
+        using pack_at_t = typename pack_head<
+            typename pack_split<I, type_pack<>, Pack>::back>::type;
+#endif
+        /**
+         * @brief elements of Pack at the positions in [Begin, End)
+         */
+        template <typename Pack, std::size_t Begin, std::size_t End>
+        using pack_slice_t = typename pack_split<
+            End - Begin,
+            type_pack<>,
+            typename pack_split<Begin, type_pack<>, Pack>::back>::front;
+        /**
+         * @brief replace the elements of Pack at the positions in
+         * [Begin, End) with the elements of Insert
+         */
+        template <typename Pack,
+                  std::size_t Begin,
+                  std::size_t End,
+                  typename Insert>
+        using pack_splice_t = typename pack_concat<
+            typename pack_concat<
+                typename pack_split<Begin, type_pack<>, Pack>::front,
+                Insert>::type,
+            typename pack_split<
+                End - Begin,
+                type_pack<>,
+                typename pack_split<Begin, type_pack<>, Pack>::back>::back>::
+            type;
+        template <bool>
+        struct pack_pick
+        {
+            template <typename Replace, typename Keep>
+            using type = Keep;
+        };
+        template <>
+        struct pack_pick<true>
+        {
+            template <typename Replace, typename Keep>
+            using type = Replace;
+        };
+        template <typename Pack, std::size_t I, typename T, typename Seq>
+        struct pack_replace;
+        template <typename... Ts, std::size_t I, typename T, std::size_t... Is>
+        struct pack_replace<type_pack<Ts...>, I, T, std::index_sequence<Is...>>
+        {
+            using type =
+                type_pack<typename pack_pick<Is == I>::template type<T, Ts>...>;
+        };
+        /**
+         * @brief replace the I-th element of Pack with T in a single
+         * instantiation, see pack_splice_t for the general case
+         */
+        template <typename Pack, std::size_t I, typename T>
+        using pack_replace_t = typename pack_replace<
+            Pack,
+            I,
+            T,
+            std::make_index_sequence<pack_size_v<Pack>>>::type;
+        template <typename Elements, typename Children>
+        inline constexpr std::size_t btree_size_v = 0;
+        template <typename... Es, typename... Cs>
+        inline constexpr std::size_t
+            btree_size_v<type_pack<Es...>, type_pack<Cs...>> =
+                sizeof...(Es) + (std::size_t{0} + ... + Cs::size);
+    } // namespace impl
+    /**
+     * @brief node definition for B-tree
+     * @tparam B maximal number of elements in a node
+     * @tparam Elements sorted kv_pairs in an impl::type_pack
+     * @tparam Children sub-trees in an impl::type_pack, one more than
+     * elements, or none for leaves
+     * @note size is memoized as it is in tavl_node.
+     */
+    template <std::size_t B, typename Elements, typename Children>
+    struct tavl_btree_node
+    {
+        static_assert(B >= 3, "nodes of tavl_btree should hold 3+ elements");
+        static constexpr std::size_t order = B;
+        using elements                     = Elements;
+        using children                     = Children;
+        static constexpr std::size_t size =
+            impl::btree_size_v<Elements, Children>;
+    };
+    /**
+     * @brief empty B-tree whose nodes hold up to B elements
+     * @note a companion of tavl_node: every node holds a pack of keys, so
+     * there are about log2(B) times fewer levels and node types.
+     */
+    template <std::size_t B = 8>
+    using tavl_btree =
+        tavl_btree_node<B, impl::type_pack<>, impl::type_pack<>>;
+    namespace impl
+    {
+        /**
+         * @brief search K in the elements of a node by fold expressions
+         * @note rank is the number of keys less than K
+         */
+        template <typename Elements, typename K>
+        struct btree_search;
+        template <typename... Es, typename K>
+        struct btree_search<type_pack<Es...>, K>
+        {
+            static constexpr std::size_t rank =
+                (std::size_t{0} + ... +
+                 (compare_v<K, typename Es::key> > 0 ? 1 : 0));
+            static constexpr bool found =
+                (false || ... || (compare_v<K, typename Es::key> == 0));
+        };
+        template <typename T>
+        inline constexpr bool btree_is_leaf_v =
+            pack_size_v<typename T::children> == 0;
+        /**
+         * @brief 0 if K is in T, 1 (2) if K is not in T and T is a leaf (an
+         * internal node)
+         */
+        template <typename T, typename K>
+        inline constexpr int btree_order_v =
+            btree_search<typename T::elements, K>::found ?
+                0 :
+                btree_is_leaf_v<T> ? 1 : 2;
+        template <typename T, typename K>
+        inline constexpr std::size_t btree_rank_v =
+            btree_search<typename T::elements, K>::rank;
+        template <typename T, std::size_t I>
+        using btree_child_t = pack_at_t<typename T::children, I>;
+        template <typename T, typename K, int = btree_order_v<T, K>>
+        struct btree_find
+        {
+            using type = empty_node;
+        };
+        template <typename T, typename K>
+        struct btree_find<T, K, 0>
+        {
+            using type = pack_at_t<typename T::elements, btree_rank_v<T, K>>;
+        };
+        template <typename T, typename K>
+        struct btree_find<T, K, 2>
+        {
+            using type =
+                typename btree_find<btree_child_t<T, btree_rank_v<T, K>>,
+                                    K>::type;
+        };
+        /**
+         * @brief build a node from Elements and Children, or split it into
+         * left, median and right if it holds more than B elements
+         */
+        template <std::size_t B,
+                  typename Elements,
+                  typename Children,
+                  bool = (pack_size_v<Elements> > B)>
+        struct btree_make
+        {
+            static constexpr bool split = false;
+            using type = tavl_btree_node<B, Elements, Children>;
+        };
+        template <std::size_t B, typename Elements, typename Children>
+        struct btree_make<B, Elements, Children, true>
+        {
+        private:
+            static constexpr std::size_t n    = pack_size_v<Elements>;
+            static constexpr std::size_t m    = n / 2;
+            static constexpr bool        leaf = pack_size_v<Children> == 0;
+
+        public:
+            static constexpr bool split = true;
+            using left =
+                tavl_btree_node<B,
+                                pack_slice_t<Elements, 0, m>,
+                                pack_slice_t<Children, 0, leaf ? 0 : m + 1>>;
+            using median = pack_at_t<Elements, m>;
+            using right  = tavl_btree_node<
+                B,
+                pack_slice_t<Elements, m + 1, n>,
+                pack_slice_t<Children, leaf ? 0 : m + 1, leaf ? 0 : n + 1>>;
+        };
+        template <typename T,
+                  std::size_t I,
+                  typename C,
+                  bool = C::split>
+        struct btree_insert_child
+            : btree_make<T::order,
+                         typename T::elements,
+                         pack_replace_t<typename T::children,
+                                        I,
+                                        typename C::type>>
+        {
+        };
+        template <typename T, std::size_t I, typename C>
+        struct btree_insert_child<T, I, C, true>
+            : btree_make<
+                  T::order,
+                  pack_splice_t<typename T::elements,
+                                I,
+                                I,
+                                type_pack<typename C::median>>,
+                  pack_splice_t<typename T::children,
+                                I,
+                                I + 1,
+                                type_pack<typename C::left, typename C::right>>>
+        {
+        };
+        /**
+         * @brief one level of insertion, nodes holding more than B elements
+         * are split on the way back
+         */
+        template <typename T, typename K, typename V, int = btree_order_v<T, K>>
+        struct btree_insert
+            : btree_make<T::order,
+                         pack_splice_t<typename T::elements,
+                                       btree_rank_v<T, K>,
+                                       btree_rank_v<T, K>,
+                                       type_pack<kv_pair<K, V>>>,
+                         typename T::children>
+        {
+        };
+        template <typename T, typename K, typename V>
+        struct btree_insert<T, K, V, 0>
+        {
+            // K is existed
+            static constexpr bool split = false;
+            using type                  = T;
+        };
+        template <typename T, typename K, typename V>
+        struct btree_insert<T, K, V, 2>
+            : btree_insert_child<
+                  T,
+                  btree_rank_v<T, K>,
+                  btree_insert<btree_child_t<T, btree_rank_v<T, K>>, K, V>>
+        {
+        };
+        template <typename R, bool = R::split>
+        struct btree_grow
+        {
+            using type = typename R::type;
+        };
+        template <typename R>
+        struct btree_grow<R, true>
+        {
+            using type = tavl_btree_node<
+                R::left::order,
+                type_pack<typename R::median>,
+                type_pack<typename R::left, typename R::right>>;
+        };
+        /**
+         * @brief the number of elements of the I-th child, 0 if there is no
+         * such child
+         */
+        template <typename Children,
+                  std::size_t I,
+                  bool = (I < pack_size_v<Children>)>
+        inline constexpr std::size_t btree_child_size_v =
+            pack_size_v<typename pack_at_t<Children, I>::elements>;
+        template <typename Children, std::size_t I>
+        inline constexpr std::size_t btree_child_size_v<Children, I, false> =
+            0;
+        /**
+         * @brief rebalancing action once the I-th child may hold less than
+         * B / 2 elements: 0 for none, 1 (2) for borrowing from the left
+         * (right) sibling, 3 (4) for merging with the left (right) sibling.
+         */
+        template <std::size_t B, typename Children, std::size_t I>
+        inline constexpr int btree_fix_action_v =
+            btree_child_size_v<Children, I> >= B / 2 ?
+                0 :
+                btree_child_size_v<Children, I - 1> > B / 2 ?
+                1 :
+                btree_child_size_v<Children, I + 1> > B / 2 ? 2 :
+                                                              I > 0 ? 3 : 4;
+        /**
+         * @brief build a node from Elements and Children after the I-th child
+         * was rebuilt by removal
+         */
+        template <std::size_t B,
+                  typename Elements,
+                  typename Children,
+                  std::size_t I,
+                  int = btree_fix_action_v<B, Children, I>>
+        struct btree_fix
+        {
+            using type = tavl_btree_node<B, Elements, Children>;
+        };
+        template <std::size_t B,
+                  typename Elements,
+                  typename Children,
+                  std::size_t I>
+        struct btree_fix<B, Elements, Children, I, 1>
+        {
+        private:
+            using lhs = pack_at_t<Children, I - 1>;
+            using cur = pack_at_t<Children, I>;
+            static constexpr std::size_t n    =
+                pack_size_v<typename lhs::elements>;
+            static constexpr bool        leaf = btree_is_leaf_v<cur>;
+            using new_lhs                     = tavl_btree_node<
+                B,
+                pack_slice_t<typename lhs::elements, 0, n - 1>,
+                pack_slice_t<typename lhs::children, 0, leaf ? 0 : n>>;
+            using new_cur = tavl_btree_node<
+                B,
+                typename pack_concat<type_pack<pack_at_t<Elements, I - 1>>,
+                                     typename cur::elements>::type,
+                typename pack_concat<
+                    pack_slice_t<typename lhs::children,
+                                 leaf ? 0 : n,
+                                 leaf ? 0 : n + 1>,
+                    typename cur::children>::type>;
+
+        public:
+            using type = tavl_btree_node<
+                B,
+                pack_splice_t<Elements,
+                              I - 1,
+                              I,
+                              type_pack<pack_at_t<typename lhs::elements,
+                                                  n - 1>>>,
+                pack_splice_t<Children,
+                              I - 1,
+                              I + 1,
+                              type_pack<new_lhs, new_cur>>>;
+        };
+        template <std::size_t B,
+                  typename Elements,
+                  typename Children,
+                  std::size_t I>
+        struct btree_fix<B, Elements, Children, I, 2>
+        {
+        private:
+            using cur = pack_at_t<Children, I>;
+            using rhs = pack_at_t<Children, I + 1>;
+            static constexpr std::size_t n    =
+                pack_size_v<typename rhs::elements>;
+            static constexpr bool        leaf = btree_is_leaf_v<cur>;
+            using new_cur                     = tavl_btree_node<
+                B,
+                typename pack_concat<typename cur::elements,
+                                     type_pack<pack_at_t<Elements, I>>>::type,
+                typename pack_concat<
+                    typename cur::children,
+                    pack_slice_t<typename rhs::children, 0, leaf ? 0 : 1>>::
+                    type>;
+            using new_rhs = tavl_btree_node<
+                B,
+                pack_slice_t<typename rhs::elements, 1, n>,
+                pack_slice_t<typename rhs::children,
+                             leaf ? 0 : 1,
+                             leaf ? 0 : n + 1>>;
+
+        public:
+            using type = tavl_btree_node<
+                B,
+                pack_splice_t<
+                    Elements,
+                    I,
+                    I + 1,
+                    type_pack<pack_at_t<typename rhs::elements, 0>>>,
+                pack_splice_t<Children,
+                              I,
+                              I + 2,
+                              type_pack<new_cur, new_rhs>>>;
+        };
+        /**
+         * @brief merge the J-th and the (J + 1)-th children with the J-th
+         * element
+         */
+        template <std::size_t B,
+                  typename Elements,
+                  typename Children,
+                  std::size_t J>
+        struct btree_merge
+        {
+        private:
+            using lhs    = pack_at_t<Children, J>;
+            using rhs    = pack_at_t<Children, J + 1>;
+            using merged = tavl_btree_node<
+                B,
+                typename pack_concat<
+                    typename pack_concat<typename lhs::elements,
+                                         type_pack<pack_at_t<Elements, J>>>::
+                        type,
+                    typename rhs::elements>::type,
+                typename pack_concat<typename lhs::children,
+                                     typename rhs::children>::type>;
+
+        public:
+            using type = tavl_btree_node<
+                B,
+                pack_splice_t<Elements, J, J + 1, type_pack<>>,
+                pack_splice_t<Children, J, J + 2, type_pack<merged>>>;
+        };
+        template <std::size_t B,
+                  typename Elements,
+                  typename Children,
+                  std::size_t I>
+        struct btree_fix<B, Elements, Children, I, 3>
+            : btree_merge<B, Elements, Children, I - 1>
+        {
+        };
+        template <std::size_t B,
+                  typename Elements,
+                  typename Children,
+                  std::size_t I>
+        struct btree_fix<B, Elements, Children, I, 4>
+            : btree_merge<B, Elements, Children, I>
+        {
+        };
+        /**
+         * @brief replace the I-th child of T with C, and the I-th element of
+         * T with E if E is given
+         */
+        template <typename T, std::size_t I, typename C, typename... E>
+        using btree_fix_t = typename btree_fix<
+            T::order,
+            pack_splice_t<typename T::elements,
+                          I,
+                          I + sizeof...(E),
+                          type_pack<E...>>,
+            pack_replace_t<typename T::children, I, C>,
+            I>::type;
+        /**
+         * @brief remove the maximal element of the non-empty tree T in one
+         * descent
+         */
+        template <typename T, bool = btree_is_leaf_v<T>>
+        struct btree_extract_max
+        {
+        private:
+            static constexpr std::size_t n =
+                pack_size_v<typename T::elements>;
+            using right_part = btree_extract_max<btree_child_t<T, n>>;
+
+        public:
+            using max  = typename right_part::max;
+            using rest = btree_fix_t<T, n, typename right_part::rest>;
+        };
+        template <typename T>
+        struct btree_extract_max<T, true>
+        {
+        private:
+            static constexpr std::size_t n =
+                pack_size_v<typename T::elements>;
+
+        public:
+            using max  = pack_at_t<typename T::elements, n - 1>;
+            using rest = tavl_btree_node<
+                T::order,
+                pack_slice_t<typename T::elements, 0, n - 1>,
+                type_pack<>>;
+        };
+        /**
+         * @brief btree_order_v, except that 3 is used if K is in T and T is
+         * an internal node
+         */
+        template <typename T, typename K>
+        inline constexpr int btree_remove_order_v =
+            btree_order_v<T, K> == 0 && !btree_is_leaf_v<T> ?
+                3 :
+                btree_order_v<T, K>;
+        /**
+         * @brief one level of removal, children left with less than B / 2
+         * elements are fixed on the way back
+         */
+        template <typename T, typename K, int = btree_remove_order_v<T, K>>
+        struct btree_remove
+        {
+            // K is not found
+            using type = T;
+        };
+        template <typename T, typename K>
+        struct btree_remove<T, K, 0>
+        {
+            using type = tavl_btree_node<T::order,
+                                         pack_splice_t<typename T::elements,
+                                                       btree_rank_v<T, K>,
+                                                       btree_rank_v<T, K> + 1,
+                                                       type_pack<>>,
+                                         type_pack<>>;
+        };
+        template <typename T, typename K>
+        struct btree_remove<T, K, 3>
+        {
+        private:
+            // replaced by its predecessor
+            using predecessor =
+                btree_extract_max<btree_child_t<T, btree_rank_v<T, K>>>;
+
+        public:
+            using type = btree_fix_t<T,
+                                     btree_rank_v<T, K>,
+                                     typename predecessor::rest,
+                                     typename predecessor::max>;
+        };
+        template <typename T, typename K>
+        struct btree_remove<T, K, 2>
+        {
+            using type = btree_fix_t<
+                T,
+                btree_rank_v<T, K>,
+                typename btree_remove<btree_child_t<T, btree_rank_v<T, K>>,
+                                      K>::type>;
+        };
+        template <typename T,
+                  bool = (pack_size_v<typename T::elements> == 0 &&
+                          !btree_is_leaf_v<T>)>
+        struct btree_shrink
+        {
+            using type = T;
+        };
+        template <typename T>
+        struct btree_shrink<T, true>
+        {
+            using type = btree_child_t<T, 0>;
+        };
+        template <typename T,
+                  std::size_t I,
+                  template <typename K, typename V>
+                  typename F,
+                  template <typename B, typename C>
+                  typename M,
+                  typename L,
+                  bool = btree_is_leaf_v<T>>
+        struct btree_for_each_child
+        {
+            using type = L;
+        };
+        /**
+         * @brief apply F and M to the elements of T in the middle order,
+         * starting from the I-th child
+         */
+        template <typename T,
+                  template <typename K, typename V>
+                  typename F,
+                  template <typename B, typename C>
+                  typename M,
+                  typename L,
+                  std::size_t I = 0,
+                  bool = (I == pack_size_v<typename T::elements>)>
+        struct btree_for_each
+        {
+        private:
+            using element = pack_at_t<typename T::elements, I>;
+            using current = typename M<
+                typename btree_for_each_child<T, I, F, M, L>::type,
+                typename F<typename element::key,
+                           typename element::value>::type>::type;
+
+        public:
+            using type =
+                typename btree_for_each<T, F, M, current, I + 1>::type;
+        };
+        template <typename T,
+                  template <typename K, typename V>
+                  typename F,
+                  template <typename B, typename C>
+                  typename M,
+                  typename L,
+                  std::size_t I>
+        struct btree_for_each<T, F, M, L, I, true>
+        {
+            using type = typename btree_for_each_child<T, I, F, M, L>::type;
+        };
+        template <typename T,
+                  std::size_t I,
+                  template <typename K, typename V>
+                  typename F,
+                  template <typename B, typename C>
+                  typename M,
+                  typename L>
+        struct btree_for_each_child<T, I, F, M, L, false>
+        {
+            using type =
+                typename btree_for_each<btree_child_t<T, I>, F, M, L>::type;
+        };
+    } // namespace impl
+    /**
+     * @brief find an element whose key is K in the B-tree T. Result is the
+     * element, empty_node otherwise.
+     * @note the elements of a node are searched by fold expressions, which
+     * compare K with every key of the node in O(1) template depth.
+     */
+    template <typename T, KeyType K>
+    struct tavl_btree_find
+    {
+        using type = typename impl::btree_find<T, K>::type;
+    };
+    template <typename T, KeyType K>
+    using tavl_btree_find_t = typename tavl_btree_find<T, K>::type;
+    template <typename T, KeyType K>
+    inline constexpr bool tavl_btree_contain_v =
+        !std::is_same_v<tavl_btree_find_t<T, K>, empty_node>;
+    /**
+     * @brief insert an (K, V) element into the B-tree T
+     * @note unlike tavl_insert, T is returned as it is if K is existed.
+     */
+    template <typename T, KeyType K, typename V = std::true_type>
+    struct tavl_btree_insert
+    {
+        using type =
+            typename impl::btree_grow<impl::btree_insert<T, K, V>>::type;
+    };
+    template <typename T, typename K, typename V = std::true_type>
+    using tavl_btree_insert_t = typename tavl_btree_insert<T, K, V>::type;
+    /**
+     * @brief try to remove the element whose key is K from the B-tree T
+     */
+    template <typename T, KeyType K>
+    struct tavl_btree_remove
+    {
+        using type = typename impl::btree_shrink<
+            typename impl::btree_remove<T, K>::type>::type;
+    };
+    template <typename T, typename K>
+    using tavl_btree_remove_t = typename tavl_btree_remove<T, K>::type;
+    /**
+     * @brief apply F<key, value> and M<previous, current-node-result> for
+     * each element of the B-tree T in the middle order, see
+     * tavl_for_each_middle_order
+     */
+    template <typename T,
+              template <typename K, typename V>
+              typename F,
+              template <typename B, typename C> typename M =
+                  tavl_for_each_middle_order_default_merge,
+              typename Init = void>
+    struct tavl_btree_for_each
+    {
+        using type = typename impl::btree_for_each<T, F, M, Init>::type;
+    };
+    template <typename T,
+              template <typename K, typename V>
+              typename F,
+              template <typename B, typename C> typename M =
+                  tavl_for_each_middle_order_default_merge,
+              typename Init = void>
+    using tavl_btree_for_each_t =
+        typename tavl_btree_for_each<T, F, M, Init>::type;
+    namespace impl
+    {
+        constexpr std::size_t popcount(std::uint32_t bits)
+        {
+            std::size_t count = 0;
+            for (; bits != 0; bits &= bits - 1)
+                ++count;
+            return count;
+        }
+    } // namespace impl
+    template <std::uint32_t Bitmap, typename... Entries>
+    struct tavl_hamt_node;
+    namespace impl
+    {
+        /**
+         * @brief elements whose keys have the same hash, they are only
+         * created once all bits of the hash are used
+         * @note elements are sorted by the names of their keys
+         */
+        template <typename... KVs>
+        struct hamt_collision
+        {
+        };
+        /**
+         * @brief 0 for an element, 1 for a sub-node and 2 for a
+         * hamt_collision
+         */
+        template <typename E>
+        inline constexpr int hamt_kind_v = 0;
+        template <std::uint32_t Bitmap, typename... Es>
+        inline constexpr int hamt_kind_v<tavl_hamt_node<Bitmap, Es...>> = 1;
+        template <typename... KVs>
+        inline constexpr int hamt_kind_v<hamt_collision<KVs...>> = 2;
+        template <typename E>
+        inline constexpr std::size_t hamt_size_v = 1;
+        template <std::uint32_t Bitmap, typename... Es>
+        inline constexpr std::size_t
+            hamt_size_v<tavl_hamt_node<Bitmap, Es...>> =
+                tavl_hamt_node<Bitmap, Es...>::size;
+        template <typename... KVs>
+        inline constexpr std::size_t hamt_size_v<hamt_collision<KVs...>> =
+            sizeof...(KVs);
+    } // namespace impl
+    /**
+     * @brief node definition for hash-array-mapped trie
+     * @tparam Bitmap the i-th bit is set if the i-th slot is used
+     * @tparam Entries used slots in order, each of them is an element
+     * (kv_pair), a sub-node or a bucket of elements with colliding hashes
+     * @note sub-nodes only exist for 2+ elements and buckets are sorted, so
+     * the same set of keys always gives the same type, whatever the order of
+     * insertions and removals is.
+     */
+    template <std::uint32_t Bitmap, typename... Entries>
+    struct tavl_hamt_node
+    {
+        static constexpr std::uint32_t bitmap = Bitmap;
+        using entries                         = impl::type_pack<Entries...>;
+        static constexpr std::size_t size =
+            (std::size_t{0} + ... + impl::hamt_size_v<Entries>);
+    };
+    /**
+     * @brief empty hash-array-mapped trie
+     * @note keys are only tested for identity by std::is_same and located by
+     * key_hash, 5 bits per level, so there are O(log32 n) levels and no
+     * compare instantiation at all. Elements are unordered.
+     */
+    using tavl_hamt = tavl_hamt_node<0>;
+    namespace impl
+    {
+        inline constexpr unsigned hamt_bits = 5;
+        // shifts from here on are out of the hash
+        inline constexpr unsigned hamt_max_shift = 64;
+        template <typename K, typename V>
+        using hamt_element = tavl_node<empty_node, empty_node, 0, K, V>;
+        template <typename K, unsigned Shift>
+        inline constexpr std::uint32_t hamt_bit_v =
+            Shift >= hamt_max_shift ?
+                0 :
+                std::uint32_t{1} << ((key_hash<K>::value >> Shift) & 31);
+        template <typename T, typename K, unsigned Shift>
+        inline constexpr bool hamt_has_slot_v =
+            (T::bitmap & hamt_bit_v<K, Shift>) != 0;
+        // position of the slot of K in the entries of T
+        template <typename T, typename K, unsigned Shift>
+        inline constexpr std::size_t hamt_position_v =
+            popcount(T::bitmap & (hamt_bit_v<K, Shift> - 1));
+        template <typename T, typename K, unsigned Shift>
+        using hamt_entry_t =
+            pack_at_t<typename T::entries, hamt_position_v<T, K, Shift>>;
+        template <std::uint32_t Bitmap, typename Entries>
+        struct hamt_make;
+        template <std::uint32_t Bitmap, typename... Es>
+        struct hamt_make<Bitmap, type_pack<Es...>>
+        {
+            using type = tavl_hamt_node<Bitmap, Es...>;
+        };
+        template <std::uint32_t Bitmap, typename Entries>
+        using hamt_make_t = typename hamt_make<Bitmap, Entries>::type;
+        template <typename K, typename... KVs>
+        struct hamt_collision_find
+        {
+            using type = empty_node;
+        };
+        template <typename K, typename KV, typename... KVs>
+        struct hamt_collision_find<K, KV, KVs...>
+            : std::conditional_t<std::is_same_v<K, typename KV::key>,
+                                 identity<KV>,
+                                 hamt_collision_find<K, KVs...>>
+        {
+        };
+        template <typename T,
+                  typename K,
+                  unsigned Shift,
+                  bool = hamt_has_slot_v<T, K, Shift>>
+        struct hamt_find
+        {
+            using type = empty_node;
+        };
+        template <typename E, typename K, unsigned Shift, int = hamt_kind_v<E>>
+        struct hamt_find_entry
+        {
+            using type = std::conditional_t<std::is_same_v<K, typename E::key>,
+                                            E,
+                                            empty_node>;
+        };
+        template <typename E, typename K, unsigned Shift>
+        struct hamt_find_entry<E, K, Shift, 1> : hamt_find<E, K, Shift>
+        {
+        };
+        template <typename... KVs, typename K, unsigned Shift>
+        struct hamt_find_entry<hamt_collision<KVs...>, K, Shift, 2>
+            : hamt_collision_find<K, KVs...>
+        {
+        };
+        template <typename T, typename K, unsigned Shift>
+        struct hamt_find<T, K, Shift, true>
+            : hamt_find_entry<hamt_entry_t<T, K, Shift>,
+                              K,
+                              Shift + hamt_bits>
+        {
+        };
+        // order of elements in a bucket of collisions
+        template <typename A, typename B>
+        inline constexpr bool hamt_key_before_v =
+            type_name<typename A::key>() < type_name<typename B::key>();
+        /**
+         * @brief the smallest trie at the level of Shift which holds two
+         * elements A and B with different keys
+         */
+        template <typename A,
+                  typename B,
+                  unsigned Shift,
+                  int = Shift >= hamt_max_shift ?
+                            0 :
+                            hamt_bit_v<typename A::key, Shift> ==
+                                    hamt_bit_v<typename B::key, Shift> ?
+                            1 :
+                            2>
+        struct hamt_pair
+        {
+            using type = std::conditional_t<hamt_key_before_v<A, B>,
+                                            hamt_collision<A, B>,
+                                            hamt_collision<B, A>>;
+        };
+        template <typename A, typename B, unsigned Shift>
+        struct hamt_pair<A, B, Shift, 1>
+        {
+            using type = tavl_hamt_node<
+                hamt_bit_v<typename A::key, Shift>,
+                typename hamt_pair<A, B, Shift + hamt_bits>::type>;
+        };
+        template <typename A, typename B, unsigned Shift>
+        struct hamt_pair<A, B, Shift, 2>
+        {
+        private:
+            static constexpr bool ordered = hamt_bit_v<typename A::key, Shift> <
+                                            hamt_bit_v<typename B::key, Shift>;
+
+        public:
+            using type = tavl_hamt_node<hamt_bit_v<typename A::key, Shift> |
+                                            hamt_bit_v<typename B::key, Shift>,
+                                        std::conditional_t<ordered, A, B>,
+                                        std::conditional_t<ordered, B, A>>;
+        };
+        template <typename T,
+                  typename K,
+                  typename V,
+                  unsigned Shift,
+                  bool = hamt_has_slot_v<T, K, Shift>>
+        struct hamt_insert;
+        // insert KV into a bucket, Less holds the elements before KV
+        template <typename KV, typename Less, typename... KVs>
+        struct hamt_collision_insert;
+        template <typename KV, typename... Ls>
+        struct hamt_collision_insert<KV, type_pack<Ls...>>
+        {
+            using type = hamt_collision<Ls..., KV>;
+        };
+        template <typename KV, typename... Ls, typename E, typename... KVs>
+        struct hamt_collision_insert<KV, type_pack<Ls...>, E, KVs...>
+            : std::conditional_t<
+                  hamt_key_before_v<KV, E>,
+                  identity<hamt_collision<Ls..., KV, E, KVs...>>,
+                  hamt_collision_insert<KV, type_pack<Ls..., E>, KVs...>>
+        {
+        };
+        // insert (K, V) into an entry at the level of Shift, the entry is
+        // returned as it is if K is existed
+        template <typename E,
+                  typename K,
+                  typename V,
+                  unsigned Shift,
+                  int = hamt_kind_v<E>>
+        struct hamt_insert_entry
+            : std::conditional_t<
+                  std::is_same_v<K, typename E::key>,
+                  identity<E>,
+                  hamt_pair<E, hamt_element<K, V>, Shift>>
+        {
+        };
+        template <typename E, typename K, typename V, unsigned Shift>
+        struct hamt_insert_entry<E, K, V, Shift, 1>
+            : hamt_insert<E, K, V, Shift>
+        {
+        };
+        template <typename... KVs, typename K, typename V, unsigned Shift>
+        struct hamt_insert_entry<hamt_collision<KVs...>, K, V, Shift, 2>
+            : std::conditional_t<
+                  (std::is_same_v<K, typename KVs::key> || ...),
+                  identity<hamt_collision<KVs...>>,
+                  hamt_collision_insert<hamt_element<K, V>,
+                                        type_pack<>,
+                                        KVs...>>
+        {
+        };
+        template <typename T, typename K, typename V, unsigned Shift, bool>
+        struct hamt_insert
+        {
+            // the slot is free
+            using type = hamt_make_t<
+                T::bitmap | hamt_bit_v<K, Shift>,
+                pack_splice_t<typename T::entries,
+                              hamt_position_v<T, K, Shift>,
+                              hamt_position_v<T, K, Shift>,
+                              type_pack<hamt_element<K, V>>>>;
+        };
+        template <typename T, typename K, typename V, unsigned Shift>
+        struct hamt_insert<T, K, V, Shift, true>
+        {
+            using type = hamt_make_t<
+                T::bitmap,
+                pack_replace_t<
+                    typename T::entries,
+                    hamt_position_v<T, K, Shift>,
+                    typename hamt_insert_entry<hamt_entry_t<T, K, Shift>,
+                                               K,
+                                               V,
+                                               Shift + hamt_bits>::type>>;
+        };
+        template <typename K, typename Removed, typename... KVs>
+        struct hamt_collision_remove
+        {
+            using type = hamt_collision<>;
+        };
+        template <typename K, typename... Rs, typename KV, typename... KVs>
+        struct hamt_collision_remove<K, type_pack<Rs...>, KV, KVs...>
+            : std::conditional_t<
+                  std::is_same_v<K, typename KV::key>,
+                  identity<hamt_collision<Rs..., KVs...>>,
+                  hamt_collision_remove<K, type_pack<Rs..., KV>, KVs...>>
+        {
+        };
+        /**
+         * @brief an entry which is left with less than 2 elements is replaced
+         * by its only element, or empty_node if there is nothing left
+         */
+        template <typename E>
+        struct hamt_collapse
+        {
+            using type = E;
+        };
+        template <>
+        struct hamt_collapse<tavl_hamt_node<0>>
+        {
+            using type = empty_node;
+        };
+        template <std::uint32_t Bitmap, typename E>
+        struct hamt_collapse<tavl_hamt_node<Bitmap, E>>
+        {
+            // buckets of collisions are kept at the bottom
+            using type =
+                std::conditional_t<hamt_kind_v<E> == 0,
+                                   E,
+                                   tavl_hamt_node<Bitmap, E>>;
+        };
+        template <typename KV>
+        struct hamt_collapse<hamt_collision<KV>>
+        {
+            using type = KV;
+        };
+        template <typename T,
+                  typename K,
+                  unsigned Shift,
+                  bool = hamt_has_slot_v<T, K, Shift>>
+        struct hamt_remove
+        {
+            using type = T;
+        };
+        // remove K from an entry at the level of Shift, result is empty_node
+        // if nothing is left
+        template <typename E, typename K, unsigned Shift, int = hamt_kind_v<E>>
+        struct hamt_remove_entry
+        {
+            using type = std::conditional_t<std::is_same_v<K, typename E::key>,
+                                            empty_node,
+                                            E>;
+        };
+        template <typename E, typename K, unsigned Shift>
+        struct hamt_remove_entry<E, K, Shift, 1>
+            : hamt_collapse<typename hamt_remove<E, K, Shift>::type>
+        {
+        };
+        template <typename... KVs, typename K, unsigned Shift>
+        struct hamt_remove_entry<hamt_collision<KVs...>, K, Shift, 2>
+            : hamt_collapse<
+                  typename hamt_collision_remove<K, type_pack<>, KVs...>::type>
+        {
+        };
+        /**
+         * @brief 0 if the entry is unchanged, 1 if it is removed and 2 if it
+         * is replaced by R
+         */
+        template <typename E, typename R>
+        inline constexpr int hamt_remove_action_v =
+            std::is_same_v<E, R> ? 0 : std::is_same_v<R, empty_node> ? 1 : 2;
+        template <typename T,
+                  typename K,
+                  unsigned Shift,
+                  typename E = hamt_entry_t<T, K, Shift>,
+                  typename R =
+                      typename hamt_remove_entry<E, K, Shift + hamt_bits>::type,
+                  int = hamt_remove_action_v<E, R>>
+        struct hamt_remove_slot
+        {
+            using type = T;
+        };
+        template <typename T,
+                  typename K,
+                  unsigned Shift,
+                  typename E,
+                  typename R>
+        struct hamt_remove_slot<T, K, Shift, E, R, 1>
+        {
+        private:
+            static constexpr std::size_t position =
+                hamt_position_v<T, K, Shift>;
+
+        public:
+            using type = hamt_make_t<T::bitmap & ~hamt_bit_v<K, Shift>,
+                                     pack_splice_t<typename T::entries,
+                                                   position,
+                                                   position + 1,
+                                                   type_pack<>>>;
+        };
+        template <typename T,
+                  typename K,
+                  unsigned Shift,
+                  typename E,
+                  typename R>
+        struct hamt_remove_slot<T, K, Shift, E, R, 2>
+        {
+            using type = hamt_make_t<
+                T::bitmap,
+                pack_replace_t<typename T::entries,
+                               hamt_position_v<T, K, Shift>,
+                               R>>;
+        };
+        template <typename T, typename K, unsigned Shift>
+        struct hamt_remove<T, K, Shift, true> : hamt_remove_slot<T, K, Shift>
+        {
+        };
+        template <template <typename K, typename V>
+                  typename F,
+                  template <typename B, typename C>
+                  typename M,
+                  typename L,
+                  typename... Es>
+        struct hamt_for_each
+        {
+            using type = L;
+        };
+        template <template <typename K, typename V>
+                  typename F,
+                  template <typename B, typename C>
+                  typename M,
+                  typename L,
+                  typename E,
+                  int = hamt_kind_v<E>>
+        struct hamt_for_each_entry
+        {
+            using type =
+                typename M<L,
+                           typename F<typename E::key,
+                                      typename E::value>::type>::type;
+        };
+        template <template <typename K, typename V>
+                  typename F,
+                  template <typename B, typename C>
+                  typename M,
+                  typename L,
+                  std::uint32_t Bitmap,
+                  typename... Es>
+        struct hamt_for_each_entry<F, M, L, tavl_hamt_node<Bitmap, Es...>, 1>
+            : hamt_for_each<F, M, L, Es...>
+        {
+        };
+        template <template <typename K, typename V>
+                  typename F,
+                  template <typename B, typename C>
+                  typename M,
+                  typename L,
+                  typename... KVs>
+        struct hamt_for_each_entry<F, M, L, hamt_collision<KVs...>, 2>
+            : hamt_for_each<F, M, L, KVs...>
+        {
+        };
+        template <template <typename K, typename V>
+                  typename F,
+                  template <typename B, typename C>
+                  typename M,
+                  typename L,
+                  typename E,
+                  typename... Es>
+        struct hamt_for_each<F, M, L, E, Es...>
+            : hamt_for_each<F,
+                            M,
+                            typename hamt_for_each_entry<F, M, L, E>::type,
+                            Es...>
+        {
+        };
+        template <typename T,
+                  template <typename K, typename V>
+                  typename F,
+                  template <typename B, typename C>
+                  typename M,
+                  typename L>
+        struct hamt_for_each_root;
+        template <std::uint32_t Bitmap,
+                  typename... Es,
+                  template <typename K, typename V>
+                  typename F,
+                  template <typename B, typename C>
+                  typename M,
+                  typename L>
+        struct hamt_for_each_root<tavl_hamt_node<Bitmap, Es...>, F, M, L>
+            : hamt_for_each<F, M, L, Es...>
         {
-            using type = std::integral_constant<std::size_t,
-                                                L::value + R::value + C::value>;
         };
     } // namespace impl
     /**
-     * @brief return the size of given tree T
-     * @tparam T tavl tree
+     * @brief find an element whose key is K in the trie T. Result is the
+     * element, empty_node otherwise.
      */
-    template <Node T>
-    struct tavl_size
+    template <typename T, typename K>
+    struct tavl_hamt_find
     {
-        static constexpr std::size_t value =
-            tavl_for_each_t<T,
-                            impl::tavl_size_node,
-                            impl::tavl_size_merger,
-                            std::integral_constant<std::size_t, 0>>::value;
+        using type = typename impl::hamt_find<T, K, 0>::type;
     };
+    template <typename T, typename K>
+    using tavl_hamt_find_t = typename tavl_hamt_find<T, K>::type;
+    template <typename T, typename K>
+    inline constexpr bool tavl_hamt_contain_v =
+        !std::is_same_v<tavl_hamt_find_t<T, K>, empty_node>;
     /**
-     * @brief return the size of given tree T
-     * @tparam T tavl tree
+     * @brief insert an (K, V) element into the trie T
+     * @note T is returned as it is if K is existed.
      */
-    template <typename T>
-    inline constexpr std::size_t tavl_size_v = tavl_size<T>::value;
+    template <typename T, typename K, typename V = std::true_type>
+    struct tavl_hamt_insert
+    {
+        using type = typename impl::hamt_insert<T, K, V, 0>::type;
+    };
+    template <typename T, typename K, typename V = std::true_type>
+    using tavl_hamt_insert_t = typename tavl_hamt_insert<T, K, V>::type;
+    /**
+     * @brief try to remove the element whose key is K from the trie T
+     */
+    template <typename T, typename K>
+    struct tavl_hamt_remove
+    {
+        using type = typename impl::hamt_remove<T, K, 0>::type;
+    };
+    template <typename T, typename K>
+    using tavl_hamt_remove_t = typename tavl_hamt_remove<T, K>::type;
+    /**
+     * @brief apply F<key, value> and M<previous, current-node-result> for
+     * each element of the trie T, see tavl_for_each_middle_order
+     * @note elements are visited in the order of their hashes, not of keys.
+     */
+    template <typename T,
+              template <typename K, typename V>
+              typename F,
+              template <typename B, typename C> typename M =
+                  tavl_for_each_middle_order_default_merge,
+              typename Init = void>
+    struct tavl_hamt_for_each
+    {
+        using type = typename impl::hamt_for_each_root<T, F, M, Init>::type;
+    };
+    template <typename T,
+              template <typename K, typename V>
+              typename F,
+              template <typename B, typename C> typename M =
+                  tavl_for_each_middle_order_default_merge,
+              typename Init = void>
+    using tavl_hamt_for_each_t =
+        typename tavl_hamt_for_each<T, F, M, Init>::type;
     template <typename Lhs, typename Rhs>
     struct tavl_is_same : std::is_same<Lhs, Rhs>
     {
     };
+    template <typename L, typename R>
+    inline constexpr bool tavl_is_same_v = tavl_is_same<L, R>::value;
+#ifdef TAVL_LEGACY_IS_SAME_IMPL
     namespace impl
     {
         template <
@@ -1055,8 +5401,6 @@ namespace tavl
         };
 
     } // namespace impl
-    template <typename L, typename R>
-    inline constexpr bool tavl_is_same_v = tavl_is_same<L, R>::value;
     // implementations for comparing between two TAVLs lexicographically
     namespace impl
     {
@@ -1544,6 +5888,245 @@ namespace tavl
             impl::another_tavl_helper<tavl_node<L2, R2, H2, K2, V2>,
                                       impl::end_of_tree_flag>>::value;
     };
+#else
+    namespace impl
+    {
+        /**
+         * @brief the number of elements in T, read from the memoized size
+         */
+        template <typename T>
+        inline constexpr std::size_t known_size_v = T::size;
+        template <typename T, typename Tail>
+        struct seq_push
+        {
+            using type = list_cons<T, Tail>;
+        };
+        template <typename Tail>
+        struct seq_push<empty_node, Tail>
+        {
+            using type = Tail;
+        };
+        // replace the head of S (a subtree) by its left subtree, its element
+        // and its right subtree
+        template <typename S>
+        using seq_expand = typename seq_push<
+            typename S::head::left,
+            list_cons<kv_pair<typename S::head::key, typename S::head::value>,
+                      typename seq_push<typename S::head::right,
+                                        typename S::tail>::type>>::type;
+        template <typename T>
+        inline constexpr bool seq_is_element =
+            is_empty_node_v<typename T::left> &&
+            is_empty_node_v<typename T::right>;
+        /**
+         * @brief equality of two elements: 0 if equal, 1 otherwise
+         */
+        struct seq_equality
+        {
+            template <typename T1, typename T2>
+            static constexpr int order =
+                tavl_is_same_v<typename T1::key, typename T2::key> &&
+                        tavl_is_same_v<typename T1::value, typename T2::value> ?
+                    0 :
+                    1;
+        };
+        template <typename T1,
+                  typename T2,
+                  int = compare_v<typename T1::key, typename T2::key>>
+        struct seq_order : std::integral_constant<int, 1>
+        {
+        };
+        template <typename T1, typename T2>
+        struct seq_order<T1, T2, -1> : std::integral_constant<int, -1>
+        {
+        };
+        template <typename T1, typename T2>
+        struct seq_order<T1, T2, 0>
+            : std::integral_constant<
+                  int,
+                  compare_v<typename T1::value, typename T2::value>>
+        {
+        };
+        /**
+         * @brief lexicographical order of two elements, keys first
+         */
+        struct seq_ordering
+        {
+            template <typename T1, typename T2>
+            static constexpr int order = seq_order<T1, T2>::value;
+        };
+        template <int Result>
+        struct seq_compare_result
+        {
+            static constexpr bool done  = true;
+            static constexpr int  value = Result;
+            using next                  = seq_compare_result;
+        };
+        template <typename A, typename B, typename Cmp>
+        struct seq_compare_state;
+        // 0: the same subtree, 1: expand A, 2: expand B, 3: expand both,
+        // 4: compare elements
+        template <typename X, typename Y>
+        inline constexpr int seq_compare_action =
+            std::is_same_v<X, Y> ?
+                0 :
+                seq_is_element<X> ?
+                (seq_is_element<Y> ? 4 : 2) :
+                seq_is_element<Y> ?
+                1 :
+                X::height > Y::height ? 1 : X::height < Y::height ? 2 : 3;
+        template <typename A, typename B, typename Cmp, int Action>
+        struct seq_compare_step
+        {
+            using type =
+                seq_compare_state<typename A::tail, typename B::tail, Cmp>;
+        };
+        template <typename A, typename B, typename Cmp>
+        struct seq_compare_step<A, B, Cmp, 1>
+        {
+            using type = seq_compare_state<seq_expand<A>, B, Cmp>;
+        };
+        template <typename A, typename B, typename Cmp>
+        struct seq_compare_step<A, B, Cmp, 2>
+        {
+            using type = seq_compare_state<A, seq_expand<B>, Cmp>;
+        };
+        template <typename A, typename B, typename Cmp>
+        struct seq_compare_step<A, B, Cmp, 3>
+        {
+            using type = seq_compare_state<seq_expand<A>, seq_expand<B>, Cmp>;
+        };
+        template <typename A, typename B, typename Cmp>
+        struct seq_compare_step<A, B, Cmp, 4>
+        {
+        private:
+            static constexpr int order =
+                Cmp::template order<typename A::head, typename B::head>;
+
+        public:
+            using type = typename std::conditional_t<
+                order == 0,
+                identity<seq_compare_state<typename A::tail,
+                                           typename B::tail,
+                                           Cmp>>,
+                identity<seq_compare_result<order>>>::type;
+        };
+        /**
+         * @brief one step of comparing the elements of two trees in order
+         * @tparam A pending subtrees and elements of the former tree
+         * @tparam B pending subtrees and elements of the latter tree
+         * @note The same subtrees are skipped at once. Only the taller head is
+         * expanded so that heads tend to meet at the same subtrees.
+         */
+        template <typename A, typename B, typename Cmp>
+        struct seq_compare_state
+        {
+            static constexpr bool done = false;
+            using next                 = typename seq_compare_step<
+                A,
+                B,
+                Cmp,
+                seq_compare_action<typename A::head, typename B::head>>::type;
+        };
+        template <typename B, typename Cmp>
+        struct seq_compare_state<list_nil, B, Cmp> : seq_compare_result<-1>
+        {
+        };
+        template <typename A, typename Cmp>
+        struct seq_compare_state<A, list_nil, Cmp> : seq_compare_result<1>
+        {
+        };
+        template <typename Cmp>
+        struct seq_compare_state<list_nil, list_nil, Cmp>
+            : seq_compare_result<0>
+        {
+        };
+        /**
+         * @brief compare the elements of trees T1 and T2 in order, stopping at
+         * the first difference
+         */
+        template <typename T1, typename T2, typename Cmp>
+        inline constexpr int seq_compare_v = iterate_until<
+            seq_compare_state<typename seq_push<T1, list_nil>::type,
+                              typename seq_push<T2, list_nil>::type,
+                              Cmp>>::type::value;
+        template <typename T1, typename T2>
+        inline constexpr bool size_differ_v =
+            known_size_v<T1> != known_size_v<T2>;
+        template <typename T1, typename T2>
+        struct is_same_tree
+        {
+            static constexpr bool value =
+                seq_compare_v<T1, T2, seq_equality> == 0;
+        };
+    } // namespace impl
+    /**
+     * @brief check whether two trees have the same elements
+     * @note The elements are compared in order and the comparison stops at
+     * the first difference. The same subtrees are skipped at once, and trees
+     * of different sizes are not walked.
+     */
+    template <Node    L1,
+              Node    R1,
+              int     H1,
+              KeyType K1,
+              typename V1,
+              Node    L2,
+              Node    R2,
+              int     H2,
+              KeyType K2,
+              typename V2>
+    struct tavl_is_same<tavl_node<L1, R1, H1, K1, V1>,
+                        tavl_node<L2, R2, H2, K2, V2>>
+    {
+    private:
+        using lhs = tavl_node<L1, R1, H1, K1, V1>;
+        using rhs = tavl_node<L2, R2, H2, K2, V2>;
+
+    public:
+        static constexpr bool value = std::conditional_t<
+            std::is_same_v<lhs, rhs> || impl::size_differ_v<lhs, rhs>,
+            std::is_same<lhs, rhs>,
+            impl::is_same_tree<lhs, rhs>>::value;
+    };
+    template <Node L1, Node R1, int H1, KeyType K1, typename V1>
+    struct tavl_is_same<tavl_node<L1, R1, H1, K1, V1>, empty_node>
+    {
+        static constexpr bool value = false;
+    };
+    template <Node L1, Node R1, int H1, KeyType K1, typename V1>
+    struct tavl_is_same<empty_node, tavl_node<L1, R1, H1, K1, V1>>
+    {
+        static constexpr bool value = false;
+    };
+    template <>
+    struct tavl_is_same<empty_node, empty_node>
+    {
+        static constexpr bool value = true;
+    };
+    /**
+     * @brief compare the elements of two trees lexicographically (keys
+     * first, then values)
+     * @note stops at the first difference, see tavl_is_same
+     */
+    template <Node    L1,
+              Node    R1,
+              int     H1,
+              KeyType K1,
+              typename V1,
+              Node    L2,
+              Node    R2,
+              int     H2,
+              KeyType K2,
+              typename V2>
+    struct compare<tavl_node<L1, R1, H1, K1, V1>, tavl_node<L2, R2, H2, K2, V2>>
+    {
+        static constexpr int value =
+            impl::seq_compare_v<tavl_node<L1, R1, H1, K1, V1>,
+                                tavl_node<L2, R2, H2, K2, V2>,
+                                impl::seq_ordering>;
+    };
+#endif
     template <Node L1, Node R1, int H1, KeyType K1, typename V1>
     struct compare<tavl_node<L1, R1, H1, K1, V1>, empty_node>
     {
@@ -1567,17 +6150,38 @@ namespace tavl
     };
     namespace impl
     {
-        template <typename T, typename K, typename V>
-        struct tavl_update_nonempty;
+        /**
+         * @brief T with its children replaced by L and R, or T itself if they
+         * are not changed
+         * @note T is only rebalanced if a new element changed the height of a
+         * child, so updating a value keeps the shape of T under any policy.
+         */
+        template <typename T,
+                  typename L,
+                  typename R,
+                  bool = std::is_same_v<L, typename T::left> &&
+                         std::is_same_v<R, typename T::right>>
+        struct upsert_node
+        {
+            using type = T;
+        };
+        template <typename T, typename L, typename R>
+        struct upsert_node<T, L, R, false>
+        {
+            using type = typename std::conditional_t<
+                L::height == T::left::height && R::height == T::right::height,
+                identity<make_node_t<L, R, typename T::key, typename T::value>>,
+                balance<L, R, typename T::key, typename T::value>>::type;
+        };
         template <typename T,
-                  typename K,
                   typename V,
-                  int = (compare_v<typename T::key, K> > 0 ?
-                             1 :
-                             compare_v<typename T::key, K> < 0 ? -1 : 0)>
-        struct tavl_update_impl;
-        template <typename T, typename K, typename V>
-        struct tavl_update_impl<T, K, V, 0>
+                  bool = std::is_same_v<V, typename T::value>>
+        struct upsert_value
+        {
+            using type = T;
+        };
+        template <typename T, typename V>
+        struct upsert_value<T, V, false>
         {
             using type = tavl_node<typename T::left,
                                    typename T::right,
@@ -1585,48 +6189,64 @@ namespace tavl
                                    typename T::key,
                                    V>;
         };
-        template <typename T, typename K, typename V>
-        struct tavl_update_impl<T, K, V, -1>
-        {
-            using type = tavl_node<
-                typename T::left,
-                typename tavl_update_nonempty<typename T::right, K, V>::type,
-                T::height,
-                typename T::key,
-                typename T::value>;
-        };
-        template <typename T, typename K, typename V>
-        struct tavl_update_impl<T, K, V, 1>
+        /**
+         * @brief set the value of K to Func<old value>::type, or insert K with
+         * Func<D>::type if K is not existed, in a single descent
+         */
+        template <typename T,
+                  typename K,
+                  template <typename Old>
+                  typename Func,
+                  typename D,
+                  int = key_order_v<K, T>>
+        struct upsert
         {
-            using type = tavl_node<
-                typename tavl_update_nonempty<typename T::left, K, V>::type,
-                typename T::right,
-                T::height,
-                typename T::key,
-                typename T::value>;
+            using type = typename upsert_node<
+                T,
+                typename upsert<typename T::left, K, Func, D>::type,
+                typename T::right>::type;
         };
-        template <typename T, typename K, typename V>
-        struct tavl_update_nonempty
+        template <typename T,
+                  typename K,
+                  template <typename Old>
+                  typename Func,
+                  typename D>
+        struct upsert<T, K, Func, D, 1>
         {
-            using type = typename tavl_update_impl<T, K, V>::type;
+            using type = typename upsert_node<
+                T,
+                typename T::left,
+                typename upsert<typename T::right, K, Func, D>::type>::type;
         };
-        template <typename K, typename V>
-        struct tavl_update_nonempty<empty_node, K, V>
+        template <typename T,
+                  typename K,
+                  template <typename Old>
+                  typename Func,
+                  typename D>
+        struct upsert<T, K, Func, D, 0>
         {
-            using type = empty_node;
+            using type = typename upsert_value<
+                T,
+                typename Func<typename T::value>::type>::type;
         };
         template <typename T,
                   typename K,
-                  typename V,
-                  bool = tavl_contain_v<T, K>>
-        struct tavl_update_exist
+                  template <typename Old>
+                  typename Func,
+                  typename D>
+        struct upsert<T, K, Func, D, 2>
         {
-            using type = typename tavl_update_nonempty<T, K, V>::type;
+            using type =
+                tavl_node<empty_node, empty_node, 0, K, typename Func<D>::type>;
         };
-        template <typename T, typename K, typename V>
-        struct tavl_update_exist<T, K, V, false>
+        template <typename V>
+        struct upsert_assign
         {
-            using type = tavl_insert_t<T, K, V>;
+            template <typename Old>
+            struct apply
+            {
+                using type = V;
+            };
         };
     } // namespace impl
     /**
@@ -1634,16 +6254,14 @@ namespace tavl
      * @tparam T AVL tree
      * @tparam K key to be updated
      * @tparam V value to be set to
+     * @note K is looked up only once. T itself is returned if its value of K
+     * already is V.
      */
     template <Node T, KeyType K, typename V>
     struct tavl_update
     {
-        using type = typename impl::tavl_update_exist<T, K, V>::type;
-    };
-    template <KeyType K, typename V>
-    struct tavl_update<empty_node, K, V>
-    {
-        using type = kv_pair<K, V>;
+        using type = typename impl::
+            upsert<T, K, impl::upsert_assign<V>::template apply, void>::type;
     };
     /**
      * @brief set the value of K to V (even if K is not existed)
@@ -1653,6 +6271,37 @@ namespace tavl
      */
     template <typename T, typename K, typename V = std::true_type>
     using tavl_update_t = typename tavl_update<T, K, V>::type;
+    /**
+     * @brief same as tavl_update_t
+     */
+    template <typename T, typename K, typename V = std::true_type>
+    using tavl_insert_or_assign_t = typename tavl_update<T, K, V>::type;
+    /**
+     * @brief set the value of K to Func<old value>::type, where the old value
+     * is D if K is not existed
+     * @tparam T AVL tree
+     * @tparam K key to be updated
+     * @tparam Func 'function' applied to the old value, which should have a
+     * member type named type
+     * @tparam D old value used for missing keys
+     * @note K is looked up only once. T itself is returned if the value of K
+     * is not changed, and unchanged sub-trees are kept as they are.
+     */
+    template <Node T,
+              KeyType K,
+              template <typename Old>
+              typename Func,
+              typename D = void>
+    struct tavl_update_with
+    {
+        using type = typename impl::upsert<T, K, Func, D>::type;
+    };
+    template <typename T,
+              typename K,
+              template <typename Old>
+              typename Func,
+              typename D = void>
+    using tavl_update_with_t = typename tavl_update_with<T, K, Func, D>::type;
     /**
      * @brief computes the union of two sets(and perform user-defined
      * actions for conflicts)
@@ -1665,6 +6314,7 @@ namespace tavl
      * @note If the same key is shown in multiple trees, Func<...>::type
      * will be used. See tavl_union is a simple version that always use the
      * first value as its result
+     * @note O(n + m) instantiations for each tree, see tavl_union
      */
     template <template <typename, typename> typename Func,
               Node Tree,
@@ -1673,56 +6323,22 @@ namespace tavl
     struct tavl_union_with_func
     {
     private:
-        template <typename Key, typename Value>
-        struct for_each_item_in_Tree
-        {
-            using type = type_pair<Key, Value>;
-        };
-        template <typename TreeBefore, typename Pair>
-        struct for_each_merger
-        {
-            template <typename Old>
-            struct update_helper
-            {
-                using type = tavl_update_t<
-                    Old,
-                    typename Pair::first_type,
-                    typename Func<
-                        typename tavl_find_t<Old,
-                                             typename Pair::first_type>::value,
-                        typename Pair::second_type>::type>;
-            };
-            using type = typename std::conditional_t<
-                tavl_contain_v<TreeBefore, typename Pair::first_type>,
-                lazy_template<update_helper, TreeBefore>,
-                lazy_template<tavl_insert,
-                              TreeBefore,
-                              typename Pair::first_type,
-                              typename Pair::second_type>>::type::type;
-        };
         using union_result =
-            tavl::tavl_for_each_middle_order_t<Tree2,
-                                               for_each_item_in_Tree,
-                                               for_each_merger,
-                                               Tree>;
-        template <template <template <typename, typename> typename,
-                            typename,
-                            typename,
-                            typename...>
-                  typename T,
-                  template <typename, typename>
-                  typename TT,
-                  typename... Args>
-        struct lazy
-        {
-            using type = T<TT, Args...>;
-        };
+            typename impl::union_merge<tavl_merge_with<Func>, Tree, Tree2>::
+                type;
 
     public:
-        using type = typename std::conditional_t<
-            sizeof...(Others) != 0,
-            lazy<tavl_union_with_func, Func, union_result, Others...>,
-            identity<identity<union_result>>>::type::type;
+        using type =
+            typename tavl_union_with_func<Func, union_result, Others...>::type;
+    };
+    template <template <typename, typename> typename Func,
+              Node Tree,
+              Node Tree2>
+    struct tavl_union_with_func<Func, Tree, Tree2>
+    {
+        using type =
+            typename impl::union_merge<tavl_merge_with<Func>, Tree, Tree2>::
+                type;
     };
     /**
      * @brief computes the union of two sets(and perform user-defined
@@ -1758,49 +6374,15 @@ namespace tavl
      * @tparam T1 the first tree to examine
      * @tparam Trees other trees
      * @note Trees can be empty
+     * @note O(n + m) instantiations for each tree, see tavl_intersect
      */
     template <template <typename Key, typename... Values> typename Func,
               Node T1,
               Node... Trees>
     struct tavl_intersect_with_func
     {
-    private:
-        template <typename Key, typename Value>
-        struct for_each_node
-        {
-            template <typename... T>
-            static Func<Key, T...> get_value(T...);
-            static auto            test()
-            {
-                return get_value(
-                    (std::declval<typename tavl_find_t<Trees, Key>::value>(),
-                     ...));
-            }
-            using type = std::conditional_t<
-                (tavl_contain_v<Trees, Key> && ...),
-                type_pair<Key,
-                          typename Func<Key,
-                                        typename tavl_find_t<T1, Key>::value,
-                                        typename tavl_find_t<Trees, Key>::
-                                            value...>::type>,
-                int>;
-        };
-        template <typename Previous, typename Current>
-        struct merger
-        {
-            using type = tavl_insert_t<Previous,
-                                       typename Current::first_type,
-                                       typename Current::second_type>;
-        };
-        template <typename Previous>
-        struct merger<Previous, int>
-        {
-            using type = Previous;
-        };
-
-    public:
         using type =
-            tavl_for_each_middle_order_t<T1, for_each_node, merger, empty_node>;
+            typename impl::intersect_with_func_impl<Func, T1, Trees...>::type;
     };
     template <template <typename Key, typename... Values> typename Func,
               Node... Trees>
@@ -1819,72 +6401,65 @@ namespace tavl
               typename... Trees>
     using tavl_intersect_with_func_t =
         typename tavl_intersect_with_func<Func, Tree, Trees...>::type;
+    /**
+     * @brief elements of T1 whose keys are not in T2
+     * @note O(n + m) instantiations, see tavl_intersect
+     */
     template <Node T1, Node T2>
     struct tavl_difference
     {
-    private:
-        template <typename Key, typename Value>
-        struct for_each_in_t1
-        {
-            using type = std::conditional_t<!tavl_contain_v<T2, Key>,
-                                            kv_pair<Key, Value>,
-                                            empty_node>;
-        };
-
-    public:
-        using type =
-            tavl_for_each_t<T1, for_each_in_t1, tavl_union_3, empty_node>;
+        using type = typename impl::
+            join_trees<impl::type_pack<impl::join_difference>, T1, T2>::type;
     };
     template <typename T1, typename T2>
     using tavl_difference_t = typename tavl_difference<T1, T2>::type;
+    /**
+     * @brief elements of T1 whose keys are not in T2, the value of result's
+     * node is typename Func<key, value, void>::type
+     * @note O(n + m) instantiations, see tavl_intersect
+     */
     template <template <typename key, typename Val1, typename Val2>
               typename Func,
               Node T1,
               Node T2>
     struct tavl_difference_with_func
     {
-    private:
-        template <typename K, typename V>
-        using call_func = kv_pair<
-            K,
-            typename Func<K, V, typename tavl_find_t<T2, K>::value>::type>;
-        template <typename Key, typename Value>
-        struct for_each_in_t1
-        {
-            using type = typename std::conditional_t<
-                !tavl_contain_v<T2, Key>,
-                lazy_template<call_func, Key, Value>,
-                identity<empty_node>>::type;
-        };
-
-    public:
-        using type =
-            tavl_for_each_t<T1, for_each_in_t1, tavl_union_3, empty_node>;
+        using type = typename impl::join_trees<
+            impl::type_pack<
+                impl::join_op<true,
+                              false,
+                              impl::difference_values<Func>::template left,
+                              impl::join_keep_former>>,
+            T1,
+            T2>::type;
     };
-    template <typename T1, typename T2>
-    using tavl_difference_with_func_t = typename tavl_difference<T1, T2>::type;
+    template <template <typename key, typename Val1, typename Val2>
+              typename Func,
+              typename T1,
+              typename T2>
+    using tavl_difference_with_func_t =
+        typename tavl_difference_with_func<Func, T1, T2>::type;
     /**
      * @brief check whether S1 is a subset of S2
      * @note value is meaningless here.
+     * @note The trees are walked in order in lockstep, no key is compared
+     * after the first one missing from S2.
      */
     template <Node S1, Node S2>
     struct tavl_is_subset
     {
     private:
-        template <typename Key, typename>
-        struct check_exist
-        {
-            using type = std::bool_constant<tavl_contain_v<S2, Key>>;
-        };
-        template <typename L, typename R, typename C>
-        struct merge
-        {
-            using type = std::bool_constant<L::value && R::value && C::value>;
-        };
+        using lhs   = impl::flatten_desc<S1>;
+        using rhs   = impl::flatten_desc<S2>;
+        using start = std::conditional_t<
+            (lhs::size::value > rhs::size::value),
+            impl::subset_failed,
+            impl::subset_state<typename lhs::type, typename rhs::type, true>>;
 
     public:
         static constexpr bool value =
-            tavl_for_each_t<S1, check_exist, merge, std::true_type>::value;
+            impl::iterate<start,
+                          lhs::size::value + rhs::size::value>::type::value;
     };
     template <typename S1, typename S2>
     inline constexpr bool tavl_is_subset_v = tavl_is_subset<S1, S2>::value;
@@ -1964,4 +6539,5 @@ namespace tavl
         };
     } // namespace Impl
 } // namespace tavl
+#undef TAVL_HAS_TYPE_PACK_ELEMENT
 #endif
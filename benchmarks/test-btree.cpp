@@ -0,0 +1,122 @@
+// TAVL -*- C++ -*-
+
+// BSD 3-Clause License
+
+// Copyright (c) 2018-2019, wxr001
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "../TAVL.hpp"
+
+// builds a table by inserting keys in a scrambled order, then looks every
+// key up and removes half of them. Nodes of tavl_btree hold up to
+// TAVL_BENCHMARK_ORDER keys, with TAVL_BENCHMARK_AVL tavl_node is used
+// instead.
+
+namespace tavl
+{
+    template <typename T, T lhs, T rhs>
+    struct compare<std::integral_constant<T, lhs>,
+                   std::integral_constant<T, rhs>>
+    {
+        static constexpr int value = lhs - rhs;
+    };
+} // namespace tavl
+#ifndef TAVL_BENCHMARK_SIZE
+#define TAVL_BENCHMARK_SIZE 2000
+#endif
+#ifndef TAVL_BENCHMARK_ORDER
+#define TAVL_BENCHMARK_ORDER 8
+#endif
+template <int val>
+using int_v = std::integral_constant<int, val>;
+using namespace tavl;
+constexpr int size = TAVL_BENCHMARK_SIZE;
+// a prime greater than any size, so that keys are a permutation
+constexpr int key(int i)
+{
+    return static_cast<int>(static_cast<long long>(i) * 7919 % size);
+}
+#ifdef TAVL_BENCHMARK_AVL
+using empty_table = empty_node;
+template <typename T, typename K>
+using insert_t = tavl_insert_t<T, K, K>;
+template <typename T, typename K>
+using remove_t = tavl_remove_t<T, K>;
+template <typename T, typename K>
+constexpr bool contain_v = tavl_contain_v<T, K>;
+#else
+using empty_table = tavl_btree<TAVL_BENCHMARK_ORDER>;
+template <typename T, typename K>
+using insert_t = tavl_btree_insert_t<T, K, K>;
+template <typename T, typename K>
+using remove_t = tavl_btree_remove_t<T, K>;
+template <typename T, typename K>
+constexpr bool contain_v = tavl_btree_contain_v<T, K>;
+#endif
+// steps are driven by impl::iterate, so the template depth stays low
+template <typename T, int I>
+struct insert_state
+{
+    using type = T;
+    using next = insert_state<insert_t<T, int_v<key(I)>>, I + 1>;
+};
+template <typename T>
+struct insert_state<T, size>
+{
+    using type = T;
+    using next = insert_state;
+};
+template <typename T, int I>
+struct remove_state
+{
+    using type = T;
+    using next = remove_state<remove_t<T, int_v<key(I) * 2 % size>>, I + 1>;
+};
+template <typename T>
+struct remove_state<T, size / 2>
+{
+    using type = T;
+    using next = remove_state;
+};
+using table = typename impl::iterate<insert_state<empty_table, 0>, size>::
+    type::type;
+using removed =
+    typename impl::iterate<remove_state<table, 0>, size / 2>::type::type;
+template <int... Is>
+constexpr bool contain_all(std::integer_sequence<int, Is...>)
+{
+    return (contain_v<table, int_v<Is>> && ...);
+}
+
+int main()
+{
+    static_assert(contain_all(std::make_integer_sequence<int, size>{}));
+    static_assert(!contain_v<removed, int_v<0>>);
+    return 0;
+}
@@ -0,0 +1,97 @@
+// TAVL -*- C++ -*-
+
+// BSD 3-Clause License
+
+// Copyright (c) 2018-2019, wxr001
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "../TAVL.hpp"
+
+// compares trees with the same elements but different shapes, and trees
+// different at the first or the last element
+
+namespace tavl
+{
+    template <typename T, T lhs, T rhs>
+    struct compare<std::integral_constant<T, lhs>,
+                   std::integral_constant<T, rhs>>
+    {
+        static constexpr int value = lhs - rhs;
+    };
+} // namespace tavl
+#ifndef TAVL_BENCHMARK_SIZE
+#define TAVL_BENCHMARK_SIZE 2000
+#endif
+template <int val>
+using int_v = std::integral_constant<int, val>;
+using namespace tavl;
+template <int Offset, int First, int Last, typename Seq>
+struct make_tree;
+template <int Offset, int First, int Last, int... Is>
+struct make_tree<Offset, First, Last, std::integer_sequence<int, Is...>>
+{
+    // the value of the first (last) element is First (Last)
+    using type = tavl_from_sorted_t<kv_pair<
+        int_v<Is + Offset>,
+        int_v<(Is == 0 ? First :
+                         Is + 1 == sizeof...(Is) ? Last : Is + Offset)>>...>;
+};
+template <int N, int Offset = 0, int First = Offset, int Last = N - 1 + Offset>
+using make_tree_t =
+    typename make_tree<Offset,
+                       First,
+                       Last,
+                       std::make_integer_sequence<int, N>>::type;
+constexpr int size = TAVL_BENCHMARK_SIZE;
+using base         = make_tree_t<size>;
+// the same elements in a tree with one more level on the left
+using shifted = tavl_remove_t<make_tree_t<size + 1, -1>, int_v<-1>>;
+// the same elements, only the path to the middle one is rebuilt
+using rebuilt =
+    tavl_insert_t<tavl_remove_t<base, int_v<size / 2>>,
+                  int_v<size / 2>,
+                  int_v<size / 2>>;
+using diff_first = make_tree_t<size, 0, -1>;
+using diff_last  = make_tree_t<size, 0, 0, -1>;
+
+int main()
+{
+    static_assert(tavl_is_same_v<base, shifted>);
+    static_assert(tavl_is_same_v<base, rebuilt>);
+    static_assert(!tavl_is_same_v<base, diff_first>);
+    static_assert(!tavl_is_same_v<base, diff_last>);
+    constexpr int orders[] = {compare_v<base, shifted>,
+                              compare_v<diff_first, base>,
+                              compare_v<diff_last, base>};
+#ifndef TAVL_LEGACY_IS_SAME_IMPL
+    // the legacy compare<tavl_node, tavl_node> depends on shapes
+    static_assert(orders[0] == 0 && orders[1] < 0 && orders[2] < 0);
+#endif
+    return orders[0];
+}
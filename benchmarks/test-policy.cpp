@@ -0,0 +1,123 @@
+// TAVL -*- C++ -*-
+
+// BSD 3-Clause License
+
+// Copyright (c) 2018-2019, wxr001
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "../TAVL.hpp"
+
+// builds a table by inserting keys in a scrambled order with the balancing
+// policy TAVL_BENCHMARK_POLICY, then looks every key up. With
+// TAVL_BENCHMARK_CHURN, half of the keys are removed and inserted again
+// instead, and the result is compared with the table.
+
+namespace tavl
+{
+    template <typename T, T lhs, T rhs>
+    struct compare<std::integral_constant<T, lhs>,
+                   std::integral_constant<T, rhs>>
+    {
+        static constexpr int value = lhs - rhs;
+    };
+} // namespace tavl
+#ifndef TAVL_BENCHMARK_SIZE
+#define TAVL_BENCHMARK_SIZE 2000
+#endif
+#ifndef TAVL_BENCHMARK_POLICY
+#define TAVL_BENCHMARK_POLICY tavl_avl_policy
+#endif
+template <int val>
+using int_v = std::integral_constant<int, val>;
+using namespace tavl;
+using policy       = TAVL_BENCHMARK_POLICY;
+constexpr int size = TAVL_BENCHMARK_SIZE;
+// a prime greater than any size, so that keys are a permutation
+constexpr int key(int i)
+{
+    return static_cast<int>(static_cast<long long>(i) * 7919 % size);
+}
+// steps are driven by impl::iterate, so the template depth stays low
+template <typename T, int I, int End, int Stride = 1>
+struct insert_state
+{
+    using type = T;
+    using next = insert_state<
+        tavl_insert_t<T, int_v<key(I) * Stride % size>, std::true_type, policy>,
+        I + 1,
+        End,
+        Stride>;
+};
+template <typename T, int End, int Stride>
+struct insert_state<T, End, End, Stride>
+{
+    using type = T;
+    using next = insert_state;
+};
+template <typename T, int I, int End>
+struct remove_state
+{
+    using type = T;
+    using next =
+        remove_state<tavl_remove_t<T, int_v<key(I) * 2 % size>, policy>,
+                     I + 1,
+                     End>;
+};
+template <typename T, int End>
+struct remove_state<T, End, End>
+{
+    using type = T;
+    using next = remove_state;
+};
+using table =
+    typename impl::iterate<insert_state<empty_node, 0, size>, size>::type::type;
+#ifdef TAVL_BENCHMARK_CHURN
+using removed = typename impl::iterate<remove_state<table, 0, size / 2>,
+                                       size / 2>::type::type;
+using restored =
+    typename impl::iterate<insert_state<removed, 0, size / 2, 2>,
+                           size / 2>::type::type;
+#else
+template <int... Is>
+constexpr bool contain_all(std::integer_sequence<int, Is...>)
+{
+    return (tavl_contain_v<table, int_v<Is>> && ...);
+}
+#endif
+
+int main()
+{
+#ifdef TAVL_BENCHMARK_CHURN
+    static_assert(removed::size == size - size / 2);
+    static_assert(tavl_is_same_v<restored, table>);
+#else
+    static_assert(contain_all(std::make_integer_sequence<int, size>{}));
+#endif
+    return 0;
+}
@@ -0,0 +1,136 @@
+// TAVL -*- C++ -*-
+
+// BSD 3-Clause License
+
+// Copyright (c) 2018-2019, wxr001
+// All rights reserved.
+
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+
+// * Neither the name of the copyright holder nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "../TAVL.hpp"
+
+// a symbol table of long identifiers sharing a common prefix, keyed by
+// fixed_string or, with TAVL_BENCHMARK_CHAR_COMPARE, by a char pack compared
+// one character per instantiation
+
+#ifndef TAVL_BENCHMARK_SIZE
+#define TAVL_BENCHMARK_SIZE 2000
+#endif
+using namespace tavl;
+#ifdef TAVL_BENCHMARK_CHAR_COMPARE
+template <char... chars>
+struct identifier
+{
+};
+namespace tavl
+{
+    template <char lhs, char... lhs_rest, char rhs, char... rhs_rest>
+    struct compare<identifier<lhs, lhs_rest...>, identifier<rhs, rhs_rest...>>
+    {
+        static constexpr int value =
+            lhs != rhs ? lhs - rhs :
+                         compare<identifier<lhs_rest...>,
+                                 identifier<rhs_rest...>>::value;
+    };
+    template <char... rhs>
+    struct compare<identifier<>, identifier<rhs...>>
+    {
+        static constexpr int value = -1;
+    };
+    template <char... lhs>
+    struct compare<identifier<lhs...>, identifier<>>
+    {
+        static constexpr int value = 1;
+    };
+    template <>
+    struct compare<identifier<>, identifier<>>
+    {
+        static constexpr int value = 0;
+    };
+} // namespace tavl
+#elif __cpp_nontype_template_args >= 201911L
+template <char... chars>
+struct identifier_literal
+{
+    static constexpr char str[] = {chars..., '\0'};
+};
+template <char... chars>
+using identifier = fixed_string<identifier_literal<chars...>::str>;
+#else
+template <char... chars>
+using identifier = fixed_string<chars...>;
+#endif
+constexpr int size            = TAVL_BENCHMARK_SIZE;
+constexpr char prefix[]       = "benchmark_symbol_table_identifier_";
+constexpr std::size_t digits  = 6;
+constexpr std::size_t name_length = sizeof(prefix) - 1 + digits;
+constexpr char name_char(std::size_t i, std::size_t j)
+{
+    if (j < sizeof(prefix) - 1)
+        return prefix[j];
+    for (j = name_length - j; j > 1; --j)
+        i /= 10;
+    return static_cast<char>('0' + i % 10);
+}
+template <std::size_t I, typename Seq>
+struct make_name;
+template <std::size_t I, std::size_t... Js>
+struct make_name<I, std::index_sequence<Js...>>
+{
+    using type = identifier<name_char(I, Js)...>;
+};
+template <std::size_t I>
+using name_t =
+    typename make_name<I, std::make_index_sequence<name_length>>::type;
+// identifiers are declared in a scrambled order
+template <int count>
+struct declare_n
+{
+    static constexpr int id = count * 7919 % size;
+    using type = tavl_insert_t<typename declare_n<count - 1>::type,
+                               name_t<id>,
+                               std::integral_constant<int, id>>;
+};
+template <>
+struct declare_n<0>
+{
+    using type = empty_node;
+};
+using symbol_table = typename declare_n<size>::type;
+template <std::size_t... Is>
+constexpr bool lookup_all(std::index_sequence<Is...>)
+{
+    return ((tavl_find_t<symbol_table, name_t<Is>>::value::value == Is) &&
+            ...);
+}
+
+int main()
+{
+    static_assert(tavl_size_v<symbol_table> == size);
+    static_assert(lookup_all(std::make_index_sequence<size>{}));
+    return 0;
+}
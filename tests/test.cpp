@@ -32,6 +32,7 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "TAVL.hpp"
+#include <string_view>
 #include <utility>
 namespace Compiler
 {
@@ -173,6 +174,29 @@ namespace tavl
     };
     template <int val>
     using int_v = std::integral_constant<int, val>;
+    // keys compared by ordinals only
+    template <int val>
+    struct ordinal_v
+    {
+    };
+    template <int val>
+    struct key_ordinal<ordinal_v<val>>
+    {
+        static constexpr int value = val;
+    };
+    template <char... chars>
+    struct name_v
+    {
+    };
+    template <char... chars>
+    struct key_ordinal<name_v<chars...>>
+    {
+    private:
+        static constexpr char data[] = {chars..., '\0'};
+
+    public:
+        static constexpr std::string_view value{data, sizeof...(chars)};
+    };
     namespace InHeaderDebug
     {
         //  tree          height
@@ -855,6 +879,45 @@ namespace tavl
                               tavl_remove_t<test_remove_double_right, int_v<1>>,
                               test_remove_result_double_right>,
                           "tavl_remove for right-left");
+            // the legacy engine does not rebalance a replaced root
+#ifndef TAVL_LEGACY_REMOVE_IMPL
+            static_assert(
+                std::is_same_v<
+                    tavl_remove_t<
+                        tavl_node<
+                            tavl_node<tavl_node<kv_pair<int_v<0>, int_v<0>>,
+                                                empty_node,
+                                                1,
+                                                int_v<1>,
+                                                int_v<1>>,
+                                      kv_pair<int_v<3>, int_v<3>>,
+                                      2,
+                                      int_v<2>,
+                                      int_v<2>>,
+                            tavl_node<empty_node,
+                                      kv_pair<int_v<7>, int_v<7>>,
+                                      1,
+                                      int_v<6>,
+                                      int_v<6>>,
+                            3,
+                            int_v<4>,
+                            int_v<4>>,
+                        int_v<4>>,
+                    tavl_node<tavl_node<kv_pair<int_v<0>, int_v<0>>,
+                                        empty_node,
+                                        1,
+                                        int_v<1>,
+                                        int_v<1>>,
+                              tavl_node<kv_pair<int_v<3>, int_v<3>>,
+                                        kv_pair<int_v<7>, int_v<7>>,
+                                        1,
+                                        int_v<6>,
+                                        int_v<6>>,
+                              2,
+                              int_v<2>,
+                              int_v<2>>>,
+                "tavl_remove rebalances after replacing the root");
+#endif
         } // namespace TestRemove
         inline namespace TestForEach
         {
@@ -907,6 +970,13 @@ namespace tavl
                 !tavl_is_same_v<test_is_same_normal, test_is_same_more> &&
                     !tavl_is_same_v<test_is_same_more, test_is_same_normal>,
                 "test for trees one is the other's subset");
+#ifndef TAVL_LEGACY_IS_SAME_IMPL
+            static_assert(
+                impl::size_differ_v<test_is_same_normal, test_is_same_more> &&
+                    !impl::size_differ_v<test_is_same_diff_order_a,
+                                         test_is_same_diff_order_b>,
+                "trees of different sizes are told apart without walking");
+#endif
             static_assert(
                 !tavl_is_same_v<
                     kv_pair<int_v<0>,
@@ -927,7 +997,1844 @@ namespace tavl
                                     test_compare_tavl_more_no_left> < 0);
             static_assert(compare_v<test_compare_tavl_less_first,
                                     test_compare_tavl_less_first> == 0);
+            using test_compare_shape_a =
+                tavl_node<tavl_node<kv_pair<int_v<1>, int_v<1>>,
+                                    empty_node,
+                                    1,
+                                    int_v<2>,
+                                    int_v<2>>,
+                          kv_pair<int_v<4>, int_v<4>>,
+                          2,
+                          int_v<3>,
+                          int_v<3>>;
+            using test_compare_shape_b =
+                tavl_node<kv_pair<int_v<1>, int_v<1>>,
+                          tavl_node<empty_node,
+                                    kv_pair<int_v<4>, int_v<4>>,
+                                    1,
+                                    int_v<3>,
+                                    int_v<3>>,
+                          2,
+                          int_v<2>,
+                          int_v<2>>;
+#ifndef TAVL_LEGACY_IS_SAME_IMPL
+            static_assert(
+                compare_v<test_compare_shape_a, test_compare_shape_b> == 0 &&
+                    tavl_is_same_v<test_compare_shape_a, test_compare_shape_b>,
+                "compare trees with the same elements in different shapes");
+#endif
+            static_assert(
+                compare_v<test_compare_shape_a,
+                          tavl_update_t<test_compare_shape_b,
+                                        int_v<4>,
+                                        int_v<5>>> < 0 &&
+                    compare_v<tavl_update_t<test_compare_shape_b,
+                                            int_v<1>,
+                                            int_v<5>>,
+                              test_compare_shape_a> > 0,
+                "compare values of the same keys");
         } // namespace TestCompareTAVL
+        inline namespace TestFromSorted
+        {
+            static_assert(std::is_same_v<tavl_from_sorted_t<>, empty_node>,
+                          "tavl_from_sorted for empty packs");
+            static_assert(
+                std::is_same_v<tavl_from_sorted_t<kv_pair<int_v<1>, int>>,
+                               kv_pair<int_v<1>, int>>,
+                "tavl_from_sorted for single element");
+            static_assert(
+                std::is_same_v<tavl_from_sorted_t<kv_pair<int_v<1>, int_v<1>>,
+                                                  kv_pair<int_v<2>, int_v<2>>,
+                                                  kv_pair<int_v<3>, int_v<3>>,
+                                                  kv_pair<int_v<5>, int_v<5>>,
+                                                  kv_pair<int_v<7>, int_v<7>>,
+                                                  kv_pair<int_v<8>, int_v<8>>,
+                                                  kv_pair<int_v<9>, int_v<9>>>,
+                               test_avl_template>,
+                "tavl_from_sorted for full trees");
+            static_assert(
+                std::is_same_v<
+                    tavl_from_sorted_t<kv_pair<int_v<1>, int_v<1>>,
+                                       kv_pair<int_v<2>, int_v<2>>,
+                                       kv_pair<int_v<3>, int_v<3>>,
+                                       kv_pair<int_v<4>, int_v<4>>>,
+                    tavl_node<tavl_node<kv_pair<int_v<1>, int_v<1>>,
+                                        empty_node,
+                                        1,
+                                        int_v<2>,
+                                        int_v<2>>,
+                              kv_pair<int_v<4>, int_v<4>>,
+                              2,
+                              int_v<3>,
+                              int_v<3>>>,
+                "tavl_from_sorted for incomplete trees");
+        } // namespace TestFromSorted
+        inline namespace TestSort
+        {
+            template <typename...>
+            struct test_pack;
+            template <typename V1, typename V2>
+            struct test_add_values
+            {
+                using type = int_v<V1::value + V2::value>;
+            };
+            static_assert(std::is_same_v<tavl_sort_t<test_pack<>>, test_pack<>>,
+                          "tavl_sort for empty packs");
+            static_assert(
+                std::is_same_v<tavl_sort_t<test_pack<kv_pair<int_v<3>>,
+                                                     kv_pair<int_v<1>>,
+                                                     kv_pair<int_v<2>>>>,
+                               test_pack<kv_pair<int_v<1>>,
+                                         kv_pair<int_v<2>>,
+                                         kv_pair<int_v<3>>>>,
+                "tavl_sort for normal packs");
+            static_assert(
+                std::is_same_v<
+                    tavl_sort_t<test_pack<kv_pair<int_v<9>>,
+                                          kv_pair<int_v<8>>,
+                                          kv_pair<int_v<7>>,
+                                          kv_pair<int_v<6>>,
+                                          kv_pair<int_v<5>>,
+                                          kv_pair<int_v<4>>,
+                                          kv_pair<int_v<3>>,
+                                          kv_pair<int_v<2>>,
+                                          kv_pair<int_v<1>>,
+                                          kv_pair<int_v<0>>>>,
+                    test_pack<kv_pair<int_v<0>>,
+                              kv_pair<int_v<1>>,
+                              kv_pair<int_v<2>>,
+                              kv_pair<int_v<3>>,
+                              kv_pair<int_v<4>>,
+                              kv_pair<int_v<5>>,
+                              kv_pair<int_v<6>>,
+                              kv_pair<int_v<7>>,
+                              kv_pair<int_v<8>>,
+                              kv_pair<int_v<9>>>>,
+                "tavl_sort for reversed packs");
+            static_assert(
+                std::is_same_v<
+                    tavl_sort_t<test_pack<kv_pair<int_v<1>, int_v<10>>,
+                                          kv_pair<int_v<0>, int_v<0>>,
+                                          kv_pair<int_v<1>, int_v<11>>,
+                                          kv_pair<int_v<1>, int_v<12>>>>,
+                    test_pack<kv_pair<int_v<0>, int_v<0>>,
+                              kv_pair<int_v<1>, int_v<10>>,
+                              kv_pair<int_v<1>, int_v<11>>,
+                              kv_pair<int_v<1>, int_v<12>>>>,
+                "tavl_sort is stable");
+            using test_unique_input = test_pack<kv_pair<int_v<0>, int_v<0>>,
+                                                kv_pair<int_v<1>, int_v<1>>,
+                                                kv_pair<int_v<1>, int_v<2>>,
+                                                kv_pair<int_v<1>, int_v<3>>,
+                                                kv_pair<int_v<2>, int_v<4>>>;
+            static_assert(
+                std::is_same_v<tavl_unique_t<test_unique_input>,
+                               test_pack<kv_pair<int_v<0>, int_v<0>>,
+                                         kv_pair<int_v<1>, int_v<1>>,
+                                         kv_pair<int_v<2>, int_v<4>>>>,
+                "tavl_unique keeping the first one");
+            static_assert(
+                std::is_same_v<tavl_unique_t<test_unique_input, tavl_keep_last>,
+                               test_pack<kv_pair<int_v<0>, int_v<0>>,
+                                         kv_pair<int_v<1>, int_v<3>>,
+                                         kv_pair<int_v<2>, int_v<4>>>>,
+                "tavl_unique keeping the last one");
+            static_assert(
+                std::is_same_v<
+                    tavl_unique_t<test_unique_input,
+                                  tavl_merge_with<test_add_values>>,
+                    test_pack<kv_pair<int_v<0>, int_v<0>>,
+                              kv_pair<int_v<1>, int_v<6>>,
+                              kv_pair<int_v<2>, int_v<4>>>>,
+                "tavl_unique merging values");
+            static_assert(
+                std::is_same_v<
+                    tavl_from_unsorted_t<kv_pair<int_v<9>, int_v<9>>,
+                                         kv_pair<int_v<1>, int_v<1>>,
+                                         kv_pair<int_v<8>, int_v<8>>,
+                                         kv_pair<int_v<2>, int_v<2>>,
+                                         kv_pair<int_v<7>, int_v<7>>,
+                                         kv_pair<int_v<3>, int_v<3>>,
+                                         kv_pair<int_v<5>, int_v<5>>>,
+                    test_avl_template>,
+                "tavl_from_unsorted for normal packs");
+            static_assert(
+                std::is_same_v<
+                    tavl_from_unsorted_t<kv_pair<int_v<2>, int_v<0>>,
+                                         kv_pair<int_v<1>, int_v<1>>,
+                                         kv_pair<int_v<2>, int_v<2>>,
+                                         kv_pair<int_v<1>, int_v<3>>,
+                                         kv_pair<int_v<3>, int_v<4>>>,
+                    tavl_from_sorted_t<kv_pair<int_v<1>, int_v<1>>,
+                                       kv_pair<int_v<2>, int_v<0>>,
+                                       kv_pair<int_v<3>, int_v<4>>>>,
+                "tavl_from_unsorted keeping the first one");
+            static_assert(
+                std::is_same_v<
+                    tavl_from_unsorted_with_t<tavl_keep_last,
+                                              kv_pair<int_v<2>, int_v<0>>,
+                                              kv_pair<int_v<1>, int_v<1>>,
+                                              kv_pair<int_v<2>, int_v<2>>,
+                                              kv_pair<int_v<1>, int_v<3>>,
+                                              kv_pair<int_v<3>, int_v<4>>>,
+                    tavl_from_sorted_t<kv_pair<int_v<1>, int_v<3>>,
+                                       kv_pair<int_v<2>, int_v<2>>,
+                                       kv_pair<int_v<3>, int_v<4>>>>,
+                "tavl_from_unsorted keeping the last one");
+            static_assert(
+                std::is_same_v<
+                    tavl_from_unsorted_with_t<tavl_merge_with<test_add_values>,
+                                              kv_pair<int_v<2>, int_v<1>>,
+                                              kv_pair<int_v<1>, int_v<1>>,
+                                              kv_pair<int_v<2>, int_v<2>>,
+                                              kv_pair<int_v<1>, int_v<3>>,
+                                              kv_pair<int_v<2>, int_v<4>>>,
+                    tavl_from_sorted_t<kv_pair<int_v<1>, int_v<4>>,
+                                       kv_pair<int_v<2>, int_v<7>>>>,
+                "tavl_from_unsorted merging values");
+        } // namespace TestSort
+        inline namespace TestUnion
+        {
+            using test_union_a =
+                tavl_from_sorted_t<kv_pair<int_v<1>, int_v<1>>,
+                                   kv_pair<int_v<3>, int_v<3>>,
+                                   kv_pair<int_v<5>, int_v<5>>>;
+            using test_union_b =
+                tavl_from_sorted_t<kv_pair<int_v<2>, int_v<2>>,
+                                   kv_pair<int_v<3>, int_v<4>>,
+                                   kv_pair<int_v<6>, int_v<6>>>;
+            static_assert(std::is_same_v<tavl_union_t<empty_node, empty_node>,
+                                         empty_node>,
+                          "tavl_union for empty trees");
+            static_assert(
+                std::is_same_v<tavl_union_t<test_union_a, empty_node>,
+                               test_union_a> &&
+                    std::is_same_v<tavl_union_t<empty_node, test_union_a>,
+                                   test_union_a>,
+                "tavl_union with an empty tree");
+            static_assert(
+                std::is_same_v<tavl_union_t<test_union_a, test_union_b>,
+                               tavl_from_sorted_t<kv_pair<int_v<1>, int_v<1>>,
+                                                  kv_pair<int_v<2>, int_v<2>>,
+                                                  kv_pair<int_v<3>, int_v<3>>,
+                                                  kv_pair<int_v<5>, int_v<5>>,
+                                                  kv_pair<int_v<6>, int_v<6>>>>,
+                "tavl_union keeps the element of the former tree");
+            static_assert(
+                std::is_same_v<tavl_union_t<test_union_b,
+                                            test_union_a,
+                                            kv_pair<int_v<0>, int_v<0>>>,
+                               tavl_from_sorted_t<kv_pair<int_v<0>, int_v<0>>,
+                                                  kv_pair<int_v<1>, int_v<1>>,
+                                                  kv_pair<int_v<2>, int_v<2>>,
+                                                  kv_pair<int_v<3>, int_v<4>>,
+                                                  kv_pair<int_v<5>, int_v<5>>,
+                                                  kv_pair<int_v<6>, int_v<6>>>>,
+                "tavl_union for multiple trees");
+            static_assert(
+                std::is_same_v<
+                    tavl_union_t<test_avl_template, test_avl_template>,
+                    test_avl_template>,
+                "tavl_union for the same tree");
+            static_assert(
+                std::is_same_v<
+                    tavl_union_with_func_t<test_add_values,
+                                           test_union_a,
+                                           test_union_b,
+                                           test_union_a>,
+                    tavl_from_sorted_t<kv_pair<int_v<1>, int_v<2>>,
+                                       kv_pair<int_v<2>, int_v<2>>,
+                                       kv_pair<int_v<3>, int_v<10>>,
+                                       kv_pair<int_v<5>, int_v<10>>,
+                                       kv_pair<int_v<6>, int_v<6>>>>,
+                "tavl_union_with_func");
+        } // namespace TestUnion
+        inline namespace TestSetOperations
+        {
+            template <typename K, typename... Vs>
+            struct test_sum_values
+            {
+                using type = int_v<(K::value + ... + Vs::value)>;
+            };
+            template <typename K, typename V, typename Missing>
+            struct test_negate_value
+            {
+                static_assert(std::is_void_v<Missing>);
+                using type = int_v<-V::value>;
+            };
+            using test_set_c = tavl_from_sorted_t<kv_pair<int_v<3>, int_v<7>>,
+                                                  kv_pair<int_v<5>, int_v<9>>,
+                                                  kv_pair<int_v<6>, int_v<8>>>;
+            static_assert(
+                std::is_same_v<tavl_intersect_t<test_union_a, test_union_b>,
+                               kv_pair<int_v<3>, int_v<3>>>,
+                "tavl_intersect keeps the element of the first tree");
+            static_assert(
+                std::is_same_v<
+                    tavl_intersect_t<test_union_b, test_union_a, test_set_c>,
+                    kv_pair<int_v<3>, int_v<4>>>,
+                "tavl_intersect for multiple trees");
+            static_assert(
+                std::is_same_v<tavl_intersect_t<test_union_a, empty_node>,
+                               empty_node> &&
+                    std::is_same_v<tavl_intersect_t<empty_node, test_union_a>,
+                                   empty_node>,
+                "tavl_intersect with an empty tree");
+            static_assert(
+                std::is_same_v<
+                    tavl_intersect_t<test_avl_template, test_avl_template>,
+                    test_avl_template>,
+                "tavl_intersect for the same tree");
+            static_assert(
+                std::is_same_v<
+                    tavl_intersect_with_func_t<test_sum_values,
+                                               test_union_b,
+                                               test_union_a,
+                                               test_set_c>,
+                    kv_pair<int_v<3>, int_v<17>>>,
+                "tavl_intersect_with_func for multiple trees");
+            static_assert(
+                std::is_same_v<
+                    tavl_intersect_with_func_t<test_sum_values, test_set_c>,
+                    tavl_from_sorted_t<kv_pair<int_v<3>, int_v<10>>,
+                                       kv_pair<int_v<5>, int_v<14>>,
+                                       kv_pair<int_v<6>, int_v<14>>>>,
+                "tavl_intersect_with_func for single tree");
+            static_assert(
+                std::is_same_v<tavl_difference_t<test_union_a, test_union_b>,
+                               tavl_from_sorted_t<kv_pair<int_v<1>, int_v<1>>,
+                                                  kv_pair<int_v<5>, int_v<5>>>>,
+                "tavl_difference");
+            static_assert(
+                std::is_same_v<tavl_difference_t<test_union_a, empty_node>,
+                               test_union_a> &&
+                    std::is_same_v<tavl_difference_t<empty_node, test_union_a>,
+                                   empty_node>,
+                "tavl_difference with an empty tree");
+            static_assert(
+                std::is_same_v<tavl_difference_with_func_t<test_negate_value,
+                                                           test_union_b,
+                                                           test_set_c>,
+                               kv_pair<int_v<2>, int_v<-2>>>,
+                "tavl_difference_with_func");
+            static_assert(tavl_is_subset_v<empty_node, empty_node> &&
+                              tavl_is_subset_v<empty_node, test_union_a>,
+                          "tavl_is_subset for empty trees");
+            static_assert(tavl_is_subset_v<test_union_a, test_union_a> &&
+                              !tavl_is_subset_v<test_union_a, empty_node>,
+                          "tavl_is_subset for the same tree");
+            static_assert(
+                tavl_is_subset_v<kv_pair<int_v<3>>, test_union_b> &&
+                    tavl_is_subset_v<tavl_from_sorted_t<kv_pair<int_v<3>>,
+                                                        kv_pair<int_v<6>>>,
+                                     test_union_b> &&
+                    !tavl_is_subset_v<tavl_from_sorted_t<kv_pair<int_v<4>>,
+                                                         kv_pair<int_v<6>>>,
+                                      test_union_b> &&
+                    !tavl_is_subset_v<tavl_from_sorted_t<kv_pair<int_v<6>>,
+                                                         kv_pair<int_v<7>>>,
+                                      test_union_b> &&
+                    !tavl_is_subset_v<test_union_a, test_union_b>,
+                "tavl_is_subset");
+        } // namespace TestSetOperations
+        inline namespace TestPosition
+        {
+            static_assert(tavl_size_v<empty_node> == 0 &&
+                              tavl_size_v<kv_pair<int_v<1>>> == 1 &&
+                              tavl_size_v<test_avl_template> == 7,
+                          "tavl_size");
+            static_assert(
+                std::is_same_v<tavl_nth_t<test_avl_template, 0>,
+                               kv_pair<int_v<1>, int_v<1>>> &&
+                    std::is_same_v<tavl_nth_t<test_avl_template, 3>,
+                                   test_avl_template> &&
+                    std::is_same_v<tavl_nth_t<test_avl_template, 5>,
+                                   typename test_avl_template::right> &&
+                    std::is_same_v<tavl_nth_t<test_avl_template, 7>,
+                                   empty_node> &&
+                    std::is_same_v<tavl_nth_t<empty_node, 0>, empty_node>,
+                "tavl_nth");
+            static_assert(tavl_rank_v<test_avl_template, int_v<0>> == 0 &&
+                              tavl_rank_v<test_avl_template, int_v<5>> == 3 &&
+                              tavl_rank_v<test_avl_template, int_v<6>> == 4 &&
+                              tavl_rank_v<test_avl_template, int_v<9>> == 6 &&
+                              tavl_rank_v<test_avl_template, int_v<10>> == 7 &&
+                              tavl_rank_v<empty_node, int_v<1>> == 0,
+                          "tavl_rank");
+            static_assert(
+                std::is_same_v<tavl_slice_t<test_avl_template, 0, 7>,
+                               test_avl_template> &&
+                    std::is_same_v<tavl_slice_t<test_avl_template, 0, 3>,
+                                   typename test_avl_template::left> &&
+                    std::is_same_v<tavl_slice_t<test_avl_template, 4, 100>,
+                                   typename test_avl_template::right>,
+                "tavl_slice reuses sub-trees");
+            static_assert(
+                std::is_same_v<tavl_slice_t<test_avl_template, 2, 5>,
+                               tavl_from_sorted_t<kv_pair<int_v<3>, int_v<3>>,
+                                                  kv_pair<int_v<5>, int_v<5>>,
+                                                  kv_pair<int_v<7>, int_v<7>>>>,
+                "tavl_slice");
+            static_assert(
+                tavl_is_same_v<tavl_slice_t<test_avl_template, 1, 7>,
+                               tavl_remove_t<test_avl_template, int_v<1>>> &&
+                    tavl_is_same_v<
+                        tavl_slice_t<test_avl_template, 0, 6>,
+                        tavl_remove_t<test_avl_template, int_v<9>>>,
+                "tavl_slice for a prefix or a suffix");
+            static_assert(
+                std::is_same_v<tavl_slice_t<test_avl_template, 3, 3>,
+                               empty_node> &&
+                    std::is_same_v<tavl_slice_t<test_avl_template, 5, 2>,
+                                   empty_node> &&
+                    std::is_same_v<tavl_slice_t<empty_node, 0, 1>, empty_node>,
+                "tavl_slice for empty ranges");
+        } // namespace TestPosition
+        inline namespace TestKeyOrdinal
+        {
+            static_assert(compare_v<ordinal_v<1>, ordinal_v<2>> == -1 &&
+                              compare_v<ordinal_v<2>, ordinal_v<2>> == 0 &&
+                              compare_v<ordinal_v<3>, ordinal_v<2>> == 1,
+                          "compare keys with integral ordinals");
+            static_assert(compare_v<name_v<'a', 'b'>, name_v<'a', 'c'>> == -1 &&
+                              compare_v<name_v<'a', 'b'>, name_v<'a'>> == 1 &&
+                              compare_v<name_v<'a'>, name_v<'a'>> == 0,
+                          "compare keys with constexpr comparable ordinals");
+            using test_ordinal_tree =
+                tavl_insert_t<tavl_insert_t<tavl_insert_t<empty_node,
+                                                          ordinal_v<3>,
+                                                          int_v<3>>,
+                                            ordinal_v<1>,
+                                            int_v<1>>,
+                              ordinal_v<2>,
+                              int_v<2>>;
+            static_assert(
+                std::is_same_v<
+                    test_ordinal_tree,
+                    tavl_from_sorted_t<kv_pair<ordinal_v<1>, int_v<1>>,
+                                       kv_pair<ordinal_v<2>, int_v<2>>,
+                                       kv_pair<ordinal_v<3>, int_v<3>>>>,
+                "tavl_insert for keys with ordinals");
+            static_assert(
+                std::is_same_v<tavl_find_t<test_ordinal_tree, ordinal_v<1>>,
+                               kv_pair<ordinal_v<1>, int_v<1>>> &&
+                    !tavl_contain_v<test_ordinal_tree, ordinal_v<4>>,
+                "tavl_find for keys with ordinals");
+            static_assert(
+                std::is_same_v<
+                    tavl_remove_t<test_ordinal_tree, ordinal_v<2>>,
+                    tavl_from_sorted_t<kv_pair<ordinal_v<1>, int_v<1>>,
+                                       kv_pair<ordinal_v<3>, int_v<3>>>>,
+                "tavl_remove for keys with ordinals");
+        } // namespace TestKeyOrdinal
+        inline namespace TestFixedString
+        {
+#if __cpp_nontype_template_args >= 201911L
+            using test_name_empty = fixed_string<"">;
+            using test_name_tavl  = fixed_string<"tavl">;
+            using test_name_tree  = fixed_string<"tree">;
+            using test_name_trees = fixed_string<"trees">;
+#else
+            using test_name_empty = fixed_string<>;
+            using test_name_tavl  = fixed_string<'t', 'a', 'v', 'l'>;
+            using test_name_tree  = fixed_string<'t', 'r', 'e', 'e'>;
+            using test_name_trees = fixed_string<'t', 'r', 'e', 'e', 's'>;
+#endif
+            static_assert(test_name_tavl::value == "tavl" &&
+                              test_name_empty::value.empty(),
+                          "fixed_string::value");
+            static_assert(
+                compare_v<test_name_tavl, test_name_tree> == -1 &&
+                    compare_v<test_name_trees, test_name_tree> == 1 &&
+                    compare_v<test_name_empty, test_name_tavl> == -1 &&
+                    compare_v<test_name_tree, test_name_tree> == 0,
+                "compare fixed_string");
+            static_assert(
+                std::is_same_v<
+                    tavl_insert_t<tavl_insert_t<tavl_insert_t<empty_node,
+                                                              test_name_trees,
+                                                              int_v<3>>,
+                                                test_name_tavl,
+                                                int_v<1>>,
+                                  test_name_tree,
+                                  int_v<2>>,
+                    tavl_from_sorted_t<kv_pair<test_name_tavl, int_v<1>>,
+                                       kv_pair<test_name_tree, int_v<2>>,
+                                       kv_pair<test_name_trees, int_v<3>>>>,
+                "tavl_insert for fixed_string keys");
+        } // namespace TestFixedString
+        inline namespace TestFlat
+        {
+            using test_flat = tavl_flatten_t<test_avl_template>;
+            static_assert(
+                std::is_same_v<test_flat,
+                               tavl_flat<kv_pair<int_v<1>, int_v<1>>,
+                                         kv_pair<int_v<2>, int_v<2>>,
+                                         kv_pair<int_v<3>, int_v<3>>,
+                                         kv_pair<int_v<5>, int_v<5>>,
+                                         kv_pair<int_v<7>, int_v<7>>,
+                                         kv_pair<int_v<8>, int_v<8>>,
+                                         kv_pair<int_v<9>, int_v<9>>>> &&
+                    std::is_same_v<tavl_flatten_t<empty_node>, tavl_flat<>>,
+                "tavl_flatten");
+            static_assert(
+                std::is_same_v<tavl_unflatten_t<test_flat>,
+                               test_avl_template> &&
+                    std::is_same_v<tavl_unflatten_t<tavl_flat<>>, empty_node>,
+                "tavl_unflatten");
+            static_assert(
+                std::is_same_v<tavl_flat_find_t<test_flat, int_v<1>>,
+                               kv_pair<int_v<1>, int_v<1>>> &&
+                    std::is_same_v<tavl_flat_find_t<test_flat, int_v<8>>,
+                                   kv_pair<int_v<8>, int_v<8>>> &&
+                    std::is_same_v<tavl_flat_find_t<test_flat, int_v<9>>,
+                                   kv_pair<int_v<9>, int_v<9>>> &&
+                    std::is_same_v<tavl_flat_find_t<test_flat, int_v<6>>,
+                                   empty_node> &&
+                    std::is_same_v<tavl_flat_find_t<tavl_flat<>, int_v<6>>,
+                                   empty_node>,
+                "tavl_flat_find");
+            static_assert(tavl_flat_contain_v<test_flat, int_v<5>> &&
+                              !tavl_flat_contain_v<test_flat, int_v<0>> &&
+                              !tavl_flat_contain_v<test_flat, int_v<10>>,
+                          "tavl_flat_contain");
+            static_assert(tavl_flat_rank_v<test_flat, int_v<0>> == 0 &&
+                              tavl_flat_rank_v<test_flat, int_v<5>> == 3 &&
+                              tavl_flat_rank_v<test_flat, int_v<6>> == 4 &&
+                              tavl_flat_rank_v<test_flat, int_v<10>> == 7,
+                          "tavl_flat_rank");
+            static_assert(
+                std::is_same_v<tavl_flat_nth_t<test_flat, 3>,
+                               kv_pair<int_v<5>, int_v<5>>> &&
+                    std::is_same_v<tavl_flat_nth_t<test_flat, 7>, empty_node>,
+                "tavl_flat_nth");
+            using test_flat_ordinals =
+                tavl_flat<kv_pair<ordinal_v<1>, int_v<1>>,
+                          kv_pair<ordinal_v<4>, int_v<4>>,
+                          kv_pair<ordinal_v<6>, int_v<6>>>;
+            static_assert(
+                std::is_same_v<
+                    tavl_flat_find_t<test_flat_ordinals, ordinal_v<4>>,
+                    kv_pair<ordinal_v<4>, int_v<4>>> &&
+                    !tavl_flat_contain_v<test_flat_ordinals, ordinal_v<5>> &&
+                    !tavl_flat_contain_v<test_flat_ordinals, ordinal_v<7>> &&
+                    tavl_flat_rank_v<test_flat_ordinals, ordinal_v<5>> == 2 &&
+                    tavl_flat_rank_v<test_flat_ordinals, ordinal_v<7>> == 3,
+                "tavl_flat lookups by ordinals");
+        } // namespace TestFlat
+        inline namespace TestBTree
+        {
+            template <typename K, typename V>
+            struct test_btree_element
+            {
+                using type = kv_pair<K, V>;
+            };
+            template <typename Previous, typename Current>
+            struct test_btree_append;
+            template <typename... KVs, typename Current>
+            struct test_btree_append<tavl_flat<KVs...>, Current>
+            {
+                using type = tavl_flat<KVs..., Current>;
+            };
+            template <typename T>
+            using test_btree_elements_t =
+                tavl_btree_for_each_t<T,
+                                      test_btree_element,
+                                      test_btree_append,
+                                      tavl_flat<>>;
+            // depth of the leaves, or -1 if T is not a valid B-tree
+            template <typename T, bool Root = true>
+            struct test_btree_depth;
+            template <std::size_t B, typename... Es, bool Root>
+            struct test_btree_depth<
+                tavl_btree_node<B, impl::type_pack<Es...>, impl::type_pack<>>,
+                Root>
+            {
+                static constexpr int value =
+                    sizeof...(Es) <= B && (Root || sizeof...(Es) >= B / 2) ?
+                        0 :
+                        -1;
+            };
+            template <std::size_t B,
+                      typename... Es,
+                      typename C,
+                      typename... Cs,
+                      bool Root>
+            struct test_btree_depth<
+                tavl_btree_node<B,
+                                impl::type_pack<Es...>,
+                                impl::type_pack<C, Cs...>>,
+                Root>
+            {
+                static constexpr int child = test_btree_depth<C, false>::value;
+                static constexpr int value =
+                    child >= 0 && sizeof...(Es) == sizeof...(Cs) &&
+                            sizeof...(Es) <= B &&
+                            (Root ? sizeof...(Es) >= 1 :
+                                    sizeof...(Es) >= B / 2) &&
+                            ((test_btree_depth<Cs, false>::value == child) &&
+                             ...) ?
+                        child + 1 :
+                        -1;
+            };
+            template <typename T, int... keys>
+            struct test_btree_insert_all
+            {
+                using type = T;
+            };
+            template <typename T, int key, int... keys>
+            struct test_btree_insert_all<T, key, keys...>
+                : test_btree_insert_all<
+                      tavl_btree_insert_t<T, int_v<key>, int_v<key * 2>>,
+                      keys...>
+            {
+            };
+            template <typename T, int... keys>
+            struct test_btree_remove_all
+            {
+                using type = T;
+            };
+            template <typename T, int key, int... keys>
+            struct test_btree_remove_all<T, key, keys...>
+                : test_btree_remove_all<tavl_btree_remove_t<T, int_v<key>>,
+                                        keys...>
+            {
+            };
+            template <int... keys>
+            using test_btree_flat_t =
+                tavl_flat<kv_pair<int_v<keys>, int_v<keys * 2>>...>;
+            using test_btree = typename test_btree_insert_all<
+                tavl_btree<3>,
+                8, 3, 15, 1, 12, 6, 19, 10, 4, 17, 2, 13, 7, 20, 9, 5, 16,
+                11, 18, 14>::type;
+            static_assert(
+                std::is_same_v<test_btree_elements_t<tavl_btree<>>,
+                               tavl_flat<>> &&
+                    tavl_btree<>::size == 0 &&
+                    std::is_same_v<tavl_btree_find_t<tavl_btree<>, int_v<1>>,
+                                   empty_node> &&
+                    std::is_same_v<tavl_btree_remove_t<tavl_btree<>, int_v<1>>,
+                                   tavl_btree<>>,
+                "tavl_btree for empty trees");
+            static_assert(
+                std::is_same_v<
+                    test_btree_elements_t<test_btree>,
+                    test_btree_flat_t<1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+                                      13, 14, 15, 16, 17, 18, 19, 20>> &&
+                    test_btree::size == 20 &&
+                    test_btree_depth<test_btree>::value > 1,
+                "tavl_btree_insert");
+            static_assert(
+                std::is_same_v<tavl_btree_insert_t<test_btree, int_v<5>>,
+                               test_btree>,
+                "tavl_btree_insert for existed keys");
+            static_assert(
+                std::is_same_v<tavl_btree_find_t<test_btree, int_v<1>>,
+                               kv_pair<int_v<1>, int_v<2>>> &&
+                    std::is_same_v<tavl_btree_find_t<test_btree, int_v<13>>,
+                                   kv_pair<int_v<13>, int_v<26>>> &&
+                    std::is_same_v<tavl_btree_find_t<test_btree, int_v<20>>,
+                                   kv_pair<int_v<20>, int_v<40>>> &&
+                    !tavl_btree_contain_v<test_btree, int_v<0>> &&
+                    !tavl_btree_contain_v<test_btree, int_v<21>>,
+                "tavl_btree_find");
+            using test_btree_removed = typename test_btree_remove_all<
+                test_btree,
+                8, 1, 20, 12, 0, 3, 15, 9, 18>::type;
+            static_assert(
+                std::is_same_v<test_btree_elements_t<test_btree_removed>,
+                               test_btree_flat_t<2, 4, 5, 6, 7, 10, 11, 13, 14,
+                                                 16, 17, 19>> &&
+                    test_btree_depth<test_btree_removed>::value >= 0,
+                "tavl_btree_remove");
+            static_assert(
+                std::is_same_v<
+                    typename test_btree_remove_all<test_btree_removed,
+                                                   2, 4, 5, 6, 7, 10, 11, 13,
+                                                   14, 16, 17, 19>::type,
+                    tavl_btree<3>>,
+                "tavl_btree_remove all elements");
+            static_assert(
+                std::is_same_v<
+                    test_btree_elements_t<typename test_btree_insert_all<
+                        tavl_btree<4>,
+                        5, 1, 9, 3, 7, 2, 8, 4, 6>::type>,
+                    test_btree_flat_t<1, 2, 3, 4, 5, 6, 7, 8, 9>>,
+                "tavl_btree_insert with an even order");
+        } // namespace TestBTree
+        inline namespace TestHamt
+        {
+            // no compare specialization for these keys
+            template <int N>
+            struct test_hamt_key
+            {
+            };
+            // keys of the same hash
+            template <int N>
+            struct test_hamt_collide
+            {
+            };
+            // kv_pair requires comparable keys with concepts
+            template <typename K, typename V = std::true_type>
+            using test_hamt_element =
+                tavl_node<empty_node, empty_node, 0, K, V>;
+            template <typename T, typename... Ks>
+            struct test_hamt_insert_all
+            {
+                using type = T;
+            };
+            template <typename T, typename K, typename... Ks>
+            struct test_hamt_insert_all<T, K, Ks...>
+                : test_hamt_insert_all<tavl_hamt_insert_t<T, K>, Ks...>
+            {
+            };
+            template <typename T, typename... Ks>
+            struct test_hamt_remove_all
+            {
+                using type = T;
+            };
+            template <typename T, typename K, typename... Ks>
+            struct test_hamt_remove_all<T, K, Ks...>
+                : test_hamt_remove_all<tavl_hamt_remove_t<T, K>, Ks...>
+            {
+            };
+            template <typename Seq, int Step = 1, int From = 0>
+            struct test_hamt_build;
+            template <int... Is, int Step, int From>
+            struct test_hamt_build<std::integer_sequence<int, Is...>,
+                                   Step,
+                                   From>
+                : test_hamt_insert_all<tavl_hamt,
+                                       test_hamt_key<From + Is * Step>...>
+            {
+            };
+            template <typename K, typename V>
+            struct test_hamt_key_value;
+            template <int N, typename V>
+            struct test_hamt_key_value<test_hamt_key<N>, V>
+            {
+                using type = int_v<N>;
+            };
+            template <typename Previous, typename Current>
+            struct test_hamt_sum
+            {
+                using type = int_v<Previous::value + Current::value>;
+            };
+            // 40 keys, so that some of them share a slot of the root
+            using test_hamt = typename test_hamt_build<
+                std::make_integer_sequence<int, 40>>::type;
+            using test_hamt_reversed = typename test_hamt_build<
+                std::make_integer_sequence<int, 40>,
+                -1,
+                39>::type;
+            using test_hamt_odd = typename test_hamt_build<
+                std::make_integer_sequence<int, 20>,
+                2,
+                1>::type;
+        } // namespace TestHamt
+    }     // namespace InHeaderDebug
+    template <int N>
+    struct key_hash<InHeaderDebug::test_hamt_collide<N>>
+    {
+        static constexpr std::uint64_t value = 42;
+    };
+    namespace InHeaderDebug
+    {
+        inline namespace TestHamt
+        {
+            using test_hamt_collisions =
+                typename test_hamt_insert_all<tavl_hamt,
+                                              test_hamt_collide<1>,
+                                              test_hamt_collide<2>,
+                                              test_hamt_key<1>,
+                                              test_hamt_collide<3>>::type;
+            static_assert(
+                tavl_hamt::size == 0 &&
+                    std::is_same_v<
+                        tavl_hamt_find_t<tavl_hamt, test_hamt_key<1>>,
+                        empty_node> &&
+                    std::is_same_v<
+                        tavl_hamt_remove_t<tavl_hamt, test_hamt_key<1>>,
+                        tavl_hamt>,
+                "tavl_hamt for empty tries");
+            static_assert(
+                test_hamt::size == 40 &&
+                    std::is_same_v<test_hamt, test_hamt_reversed> &&
+                    std::is_same_v<tavl_hamt_insert_t<test_hamt,
+                                                      test_hamt_key<7>,
+                                                      int_v<7>>,
+                                   test_hamt>,
+                "tavl_hamt_insert");
+            static_assert(
+                std::is_same_v<
+                    tavl_hamt_find_t<test_hamt, test_hamt_key<0>>,
+                    test_hamt_element<test_hamt_key<0>>> &&
+                    std::is_same_v<
+                        tavl_hamt_find_t<tavl_hamt_insert_t<test_hamt,
+                                                            test_hamt_key<40>,
+                                                            int_v<40>>,
+                                         test_hamt_key<40>>,
+                        test_hamt_element<test_hamt_key<40>, int_v<40>>> &&
+                    tavl_hamt_contain_v<test_hamt, test_hamt_key<39>> &&
+                    !tavl_hamt_contain_v<test_hamt, test_hamt_key<40>> &&
+                    !tavl_hamt_contain_v<test_hamt, int_v<1>>,
+                "tavl_hamt_find");
+            static_assert(
+                std::is_same_v<
+                    typename test_hamt_remove_all<
+                        test_hamt,
+                        test_hamt_key<0>, test_hamt_key<2>, test_hamt_key<4>,
+                        test_hamt_key<6>, test_hamt_key<8>, test_hamt_key<10>,
+                        test_hamt_key<12>, test_hamt_key<14>,
+                        test_hamt_key<16>, test_hamt_key<18>,
+                        test_hamt_key<20>, test_hamt_key<22>,
+                        test_hamt_key<24>, test_hamt_key<26>,
+                        test_hamt_key<28>, test_hamt_key<30>,
+                        test_hamt_key<32>, test_hamt_key<34>,
+                        test_hamt_key<36>, test_hamt_key<38>,
+                        test_hamt_key<40>>::type,
+                    test_hamt_odd> &&
+                    std::is_same_v<
+                        typename test_hamt_remove_all<
+                            test_hamt_odd,
+                            test_hamt_key<1>, test_hamt_key<3>,
+                            test_hamt_key<5>, test_hamt_key<7>,
+                            test_hamt_key<9>, test_hamt_key<11>,
+                            test_hamt_key<13>, test_hamt_key<15>,
+                            test_hamt_key<17>, test_hamt_key<19>,
+                            test_hamt_key<21>, test_hamt_key<23>,
+                            test_hamt_key<25>, test_hamt_key<27>,
+                            test_hamt_key<29>, test_hamt_key<31>,
+                            test_hamt_key<33>, test_hamt_key<35>,
+                            test_hamt_key<37>, test_hamt_key<39>>::type,
+                        tavl_hamt>,
+                "tavl_hamt_remove");
+            static_assert(
+                tavl_hamt_for_each_t<test_hamt,
+                                     test_hamt_key_value,
+                                     test_hamt_sum,
+                                     int_v<0>>::value == 39 * 40 / 2 &&
+                    tavl_hamt_for_each_t<tavl_hamt,
+                                         test_hamt_key_value,
+                                         test_hamt_sum,
+                                         int_v<0>>::value == 0,
+                "tavl_hamt_for_each");
+            static_assert(
+                test_hamt_collisions::size == 4 &&
+                    tavl_hamt_contain_v<test_hamt_collisions,
+                                        test_hamt_collide<1>> &&
+                    tavl_hamt_contain_v<test_hamt_collisions,
+                                        test_hamt_collide<3>> &&
+                    tavl_hamt_contain_v<test_hamt_collisions,
+                                        test_hamt_key<1>> &&
+                    !tavl_hamt_contain_v<test_hamt_collisions,
+                                         test_hamt_collide<4>> &&
+                    std::is_same_v<
+                        tavl_hamt_insert_t<test_hamt_collisions,
+                                           test_hamt_collide<2>>,
+                        test_hamt_collisions> &&
+                    std::is_same_v<
+                        typename test_hamt_remove_all<test_hamt_collisions,
+                                                      test_hamt_collide<3>,
+                                                      test_hamt_collide<1>>::
+                            type,
+                        typename test_hamt_insert_all<tavl_hamt,
+                                                      test_hamt_key<1>,
+                                                      test_hamt_collide<2>>::
+                            type>,
+                "tavl_hamt with colliding hashes");
+            static_assert(
+                std::is_same_v<
+                    typename test_hamt_insert_all<tavl_hamt,
+                                                  test_hamt_collide<3>,
+                                                  test_hamt_key<1>,
+                                                  test_hamt_collide<2>,
+                                                  test_hamt_collide<1>>::type,
+                    test_hamt_collisions> &&
+                    std::is_same_v<
+                        typename test_hamt_insert_all<tavl_hamt,
+                                                      test_hamt_collide<2>,
+                                                      test_hamt_collide<3>,
+                                                      test_hamt_collide<1>,
+                                                      test_hamt_key<1>>::type,
+                        test_hamt_collisions>,
+                "colliding hashes inserted in other orders");
+            static_assert(
+                std::is_same_v<
+                    tavl_hamt_remove_t<test_hamt_collisions,
+                                       test_hamt_collide<2>>,
+                    typename test_hamt_insert_all<tavl_hamt,
+                                                  test_hamt_collide<3>,
+                                                  test_hamt_key<1>,
+                                                  test_hamt_collide<1>>::
+                        type> &&
+                    std::is_same_v<
+                        typename test_hamt_remove_all<test_hamt_collisions,
+                                                      test_hamt_key<1>,
+                                                      test_hamt_collide<1>>::
+                            type,
+                        typename test_hamt_insert_all<tavl_hamt,
+                                                      test_hamt_collide<3>,
+                                                      test_hamt_collide<2>>::
+                            type>,
+                "colliding hashes removed");
+        } // namespace TestHamt
+        inline namespace TestPolicy
+        {
+            template <typename Policy, typename T, int... keys>
+            struct test_policy_insert_all
+            {
+                using type = T;
+            };
+            template <typename Policy, typename T, int key, int... keys>
+            struct test_policy_insert_all<Policy, T, key, keys...>
+                : test_policy_insert_all<
+                      Policy,
+                      tavl_insert_t<T, int_v<key>, int_v<key>, Policy>,
+                      keys...>
+            {
+            };
+            // insertions with the default policy
+            template <typename T, int... keys>
+            struct test_default_insert_all
+            {
+                using type = T;
+            };
+            template <typename T, int key, int... keys>
+            struct test_default_insert_all<T, key, keys...>
+                : test_default_insert_all<
+                      tavl_insert_t<T, int_v<key>, int_v<key>>,
+                      keys...>
+            {
+            };
+            template <typename Policy, typename T, int... keys>
+            struct test_policy_remove_all
+            {
+                using type = T;
+            };
+            template <typename Policy, typename T, int key, int... keys>
+            struct test_policy_remove_all<Policy, T, key, keys...>
+                : test_policy_remove_all<Policy,
+                                         tavl_remove_t<T, int_v<key>, Policy>,
+                                         keys...>
+            {
+            };
+            template <typename Policy, typename L, typename R, typename K>
+            inline constexpr bool test_policy_node_v = true;
+            template <typename L, typename R, typename K>
+            inline constexpr bool
+                test_policy_node_v<tavl_avl_policy, L, R, K> =
+                    L::height - R::height <= 1 && R::height - L::height <= 1;
+            template <typename L, typename R, typename K>
+            inline constexpr bool
+                test_policy_node_v<tavl_weight_policy, L, R, K> =
+                    L::size + R::size <= 1 ||
+                    (L::size <= 3 * R::size && R::size <= 3 * L::size);
+            template <typename T, typename K>
+            inline constexpr bool test_policy_priority_v =
+                is_empty_node_v<T> ||
+                key_hash<typename T::key>::value <= key_hash<K>::value;
+            template <typename L, typename R, typename K>
+            inline constexpr bool
+                test_policy_node_v<tavl_treap_policy, L, R, K> =
+                    test_policy_priority_v<L, K> &&
+                    test_policy_priority_v<R, K>;
+            // whether heights are right and every node keeps the invariant
+            // of Policy (no invariant for void)
+            template <typename Policy, typename T>
+            struct test_policy_valid
+            {
+                static constexpr bool value =
+                    T::height == (T::left::height > T::right::height ?
+                                      T::left::height + 1 :
+                                      T::right::height + 1) &&
+                    test_policy_node_v<Policy,
+                                       typename T::left,
+                                       typename T::right,
+                                       typename T::key> &&
+                    test_policy_valid<Policy, typename T::left>::value &&
+                    test_policy_valid<Policy, typename T::right>::value;
+            };
+            template <typename Policy>
+            struct test_policy_valid<Policy, empty_node> : std::true_type
+            {
+            };
+            template <int... keys>
+            using test_policy_flat_t =
+                tavl_flat<kv_pair<int_v<keys>, int_v<keys>>...>;
+            template <typename Policy>
+            using test_policy_tree = typename test_policy_insert_all<
+                Policy,
+                empty_node,
+                8, 3, 15, 1, 12, 6, 19, 10, 4, 17, 2, 13, 7, 20, 9, 5, 16,
+                11, 18, 14>::type;
+            template <typename Policy>
+            using test_policy_removed =
+                typename test_policy_remove_all<Policy,
+                                                test_policy_tree<Policy>,
+                                                8, 1, 20, 12, 0, 3, 15, 9,
+                                                18>::type;
+            template <typename Policy>
+            inline constexpr bool test_policy_v =
+                test_policy_valid<Policy, test_policy_tree<Policy>>::value &&
+                std::is_same_v<
+                    tavl_flatten_t<test_policy_tree<Policy>>,
+                    test_policy_flat_t<1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+                                       13, 14, 15, 16, 17, 18, 19, 20>> &&
+                test_policy_valid<Policy,
+                                  test_policy_removed<Policy>>::value &&
+                std::is_same_v<tavl_flatten_t<test_policy_removed<Policy>>,
+                               test_policy_flat_t<2, 4, 5, 6, 7, 10, 11, 13,
+                                                  14, 16, 17, 19>> &&
+                std::is_same_v<
+                    typename test_policy_remove_all<
+                        Policy,
+                        test_policy_removed<Policy>,
+                        2, 4, 5, 6, 7, 10, 11, 13, 14, 16, 17, 19>::type,
+                    empty_node>;
+            static_assert(
+                std::is_same_v<test_policy_tree<tavl_avl_policy>,
+                               typename test_default_insert_all<
+                                   empty_node,
+                                   8, 3, 15, 1, 12, 6, 19, 10, 4, 17, 2, 13,
+                                   7, 20, 9, 5, 16, 11, 18, 14>::type> &&
+                    test_policy_v<tavl_avl_policy>,
+                "tavl_avl_policy");
+            static_assert(test_policy_v<tavl_weight_policy>,
+                          "tavl_weight_policy");
+            static_assert(test_policy_v<tavl_treap_policy>,
+                          "tavl_treap_policy");
+            static_assert(
+                std::is_same_v<
+                    test_policy_tree<tavl_treap_policy>,
+                    typename test_policy_insert_all<
+                        tavl_treap_policy,
+                        empty_node,
+                        1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+                        17, 18, 19, 20>::type> &&
+                    std::is_same_v<
+                        test_policy_removed<tavl_treap_policy>,
+                        typename test_policy_insert_all<
+                            tavl_treap_policy,
+                            empty_node,
+                            19, 17, 16, 14, 13, 11, 10, 7, 6, 5, 4, 2>::type>,
+                "tavl_treap_policy gives the same type for the same keys");
+            // updating a value keeps the shape of T
+            template <typename T, int... keys>
+            inline constexpr bool test_policy_update_v =
+                (std::is_same_v<
+                     tavl_update_t<
+                         tavl_update_t<T, int_v<keys>, std::false_type>,
+                         int_v<keys>,
+                         int_v<keys>>,
+                     T> &&
+                 ...);
+            static_assert(
+                test_policy_update_v<test_policy_tree<tavl_treap_policy>,
+                                     1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+                                     13, 14, 15, 16, 17, 18, 19, 20>,
+                "tavl_update_t keeps the shape of a treap");
+            // a treap changed by the default policy is not balanced by
+            // either policy, but its heights are still right
+            using test_policy_mixed = typename test_policy_insert_all<
+                tavl_avl_policy,
+                test_policy_tree<tavl_treap_policy>,
+                0, 21, 22, 23, 24>::type;
+            static_assert(
+                test_policy_valid<void, test_policy_mixed>::value &&
+                    std::is_same_v<
+                        tavl_flatten_t<test_policy_mixed>,
+                        test_policy_flat_t<0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                           11, 12, 13, 14, 15, 16, 17, 18,
+                                           19, 20, 21, 22, 23, 24>>,
+                "inserting into a tree built under another policy");
+            // the left child of the root is not balanced, inserting 25
+            // rotates the root
+            using test_policy_unbalanced = tavl_node<
+                tavl_node<empty_node,
+                          tavl_node<kv_pair<int_v<20>>,
+                                    kv_pair<int_v<40>>,
+                                    1,
+                                    int_v<30>,
+                                    std::true_type>,
+                          2,
+                          int_v<10>,
+                          std::true_type>,
+                tavl_node<empty_node,
+                          kv_pair<int_v<70>>,
+                          1,
+                          int_v<60>,
+                          std::true_type>,
+                3,
+                int_v<50>,
+                std::true_type>;
+            static_assert(
+                !test_policy_valid<tavl_avl_policy,
+                                   test_policy_unbalanced>::value &&
+                    test_policy_valid<void, test_policy_unbalanced>::value,
+                "test_policy_valid checks the balance of AVL trees");
+            static_assert(
+                test_policy_valid<
+                    void,
+                    tavl_insert_t<test_policy_unbalanced, int_v<25>>>::value,
+                "tavl_insert_t computes heights from the children");
+        } // namespace TestPolicy
+        inline namespace TestInsertMany
+        {
+            // whether heights are right and T is balanced
+            template <typename T>
+            struct test_avl_valid
+            {
+                static constexpr int diff =
+                    T::left::height - T::right::height;
+                static constexpr bool value =
+                    T::height == (diff > 0 ? T::left::height + 1 :
+                                             T::right::height + 1) &&
+                    diff <= 1 && diff >= -1 &&
+                    test_avl_valid<typename T::left>::value &&
+                    test_avl_valid<typename T::right>::value;
+            };
+            template <>
+            struct test_avl_valid<empty_node> : std::true_type
+            {
+            };
+            template <int... keys>
+            using test_many_flat_t =
+                tavl_flat<kv_pair<int_v<keys>, int_v<keys>>...>;
+            template <int... keys>
+            using test_many_tree_t =
+                tavl_from_sorted_t<kv_pair<int_v<keys>, int_v<keys>>...>;
+            using test_many_inserted = tavl_insert_many_t<
+                test_many_tree_t<2, 4, 6, 8, 10>,
+                kv_pair<int_v<9>, int_v<9>>,
+                kv_pair<int_v<1>, int_v<1>>,
+                kv_pair<int_v<4>, int_v<0>>,
+                kv_pair<int_v<12>, int_v<12>>,
+                kv_pair<int_v<7>, int_v<7>>,
+                kv_pair<int_v<1>, int_v<0>>,
+                kv_pair<int_v<11>, int_v<11>>,
+                kv_pair<int_v<13>, int_v<13>>,
+                kv_pair<int_v<14>, int_v<14>>,
+                kv_pair<int_v<15>, int_v<15>>,
+                kv_pair<int_v<16>, int_v<16>>,
+                kv_pair<int_v<17>, int_v<17>>>;
+            static_assert(
+                std::is_same_v<tavl_insert_many_t<empty_node>, empty_node> &&
+                    std::is_same_v<
+                        tavl_insert_many_t<test_many_tree_t<1, 2, 3>>,
+                        test_many_tree_t<1, 2, 3>> &&
+                    std::is_same_v<
+                        tavl_insert_many_t<empty_node,
+                                           kv_pair<int_v<3>, int_v<3>>,
+                                           kv_pair<int_v<1>, int_v<1>>,
+                                           kv_pair<int_v<2>, int_v<2>>>,
+                        test_many_tree_t<1, 2, 3>>,
+                "tavl_insert_many for empty trees and batches");
+            static_assert(
+                test_avl_valid<test_many_inserted>::value &&
+                    std::is_same_v<
+                        tavl_flatten_t<test_many_inserted>,
+                        test_many_flat_t<1, 2, 4, 6, 7, 8, 9, 10, 11, 12, 13,
+                                         14, 15, 16, 17>>,
+                "tavl_insert_many keeps existing and first elements");
+            static_assert(
+                std::is_same_v<
+                    tavl_insert_many_t<test_many_tree_t<2, 4, 6>,
+                                       kv_pair<int_v<4>, int_v<0>>>,
+                    test_many_tree_t<2, 4, 6>>,
+                "tavl_insert_many for existing keys");
+            using test_many_removed =
+                tavl_remove_many_t<test_many_inserted,
+                                   int_v<8>,
+                                   int_v<1>,
+                                   int_v<17>,
+                                   int_v<3>,
+                                   int_v<13>,
+                                   int_v<12>,
+                                   int_v<14>,
+                                   int_v<16>,
+                                   int_v<15>,
+                                   int_v<8>>;
+            static_assert(
+                test_avl_valid<test_many_removed>::value &&
+                    std::is_same_v<
+                        tavl_flatten_t<test_many_removed>,
+                        test_many_flat_t<2, 4, 6, 7, 9, 10, 11>>,
+                "tavl_remove_many");
+            static_assert(
+                std::is_same_v<tavl_remove_many_t<test_many_removed>,
+                               test_many_removed> &&
+                    std::is_same_v<
+                        tavl_remove_many_t<test_many_removed, int_v<0>>,
+                        test_many_removed> &&
+                    std::is_same_v<tavl_remove_many_t<test_many_removed,
+                                                      int_v<11>,
+                                                      int_v<10>,
+                                                      int_v<9>,
+                                                      int_v<7>,
+                                                      int_v<6>,
+                                                      int_v<4>,
+                                                      int_v<2>>,
+                                   empty_node>,
+                "tavl_remove_many for missing keys and all keys");
+        } // namespace TestInsertMany
+        inline namespace TestSplitJoin
+        {
+            using test_split_tree = test_many_tree_t<1, 2, 3, 4, 5, 6, 7, 8,
+                                                     9, 10, 11, 12, 13, 14,
+                                                     15, 16, 17, 18, 19, 20>;
+            using test_split_found = tavl_split<test_split_tree, int_v<13>>;
+            using test_split_missing =
+                tavl_split<test_many_tree_t<2, 4, 6, 8, 10, 12>, int_v<5>>;
+            static_assert(
+                std::is_same_v<typename tavl_split<empty_node, int_v<1>>::less,
+                               empty_node> &&
+                    std::is_same_v<
+                        typename tavl_split<empty_node, int_v<1>>::found,
+                        empty_node> &&
+                    std::is_same_v<
+                        typename tavl_split<empty_node, int_v<1>>::greater,
+                        empty_node>,
+                "tavl_split for empty trees");
+            static_assert(
+                test_avl_valid<typename test_split_found::less>::value &&
+                    test_avl_valid<typename test_split_found::greater>::value &&
+                    std::is_same_v<
+                        tavl_flatten_t<typename test_split_found::less>,
+                        test_many_flat_t<1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+                                         12>> &&
+                    std::is_same_v<typename test_split_found::found,
+                                   kv_pair<int_v<13>, int_v<13>>> &&
+                    std::is_same_v<
+                        tavl_flatten_t<typename test_split_found::greater>,
+                        test_many_flat_t<14, 15, 16, 17, 18, 19, 20>>,
+                "tavl_split for existing keys");
+            static_assert(
+                std::is_same_v<
+                    tavl_flatten_t<typename test_split_missing::less>,
+                    test_many_flat_t<2, 4>> &&
+                    std::is_same_v<typename test_split_missing::found,
+                                   empty_node> &&
+                    std::is_same_v<
+                        tavl_flatten_t<typename test_split_missing::greater>,
+                        test_many_flat_t<6, 8, 10, 12>>,
+                "tavl_split for missing keys");
+            using test_join_tall =
+                tavl_join_t<test_many_tree_t<1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                             11, 12, 13, 14, 15>,
+                            int_v<16>,
+                            int_v<16>,
+                            test_many_tree_t<17>>;
+            using test_join_short =
+                tavl_join_t<empty_node,
+                            int_v<0>,
+                            int_v<0>,
+                            test_many_tree_t<1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                             11, 12, 13, 14, 15>>;
+            static_assert(
+                test_avl_valid<test_join_tall>::value &&
+                    std::is_same_v<
+                        tavl_flatten_t<test_join_tall>,
+                        test_many_flat_t<1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+                                         12, 13, 14, 15, 16, 17>> &&
+                    test_avl_valid<test_join_short>::value &&
+                    std::is_same_v<
+                        tavl_flatten_t<test_join_short>,
+                        test_many_flat_t<0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+                                         12, 13, 14, 15>> &&
+                    std::is_same_v<tavl_join_t<test_many_tree_t<1>,
+                                               int_v<2>,
+                                               int_v<2>,
+                                               test_many_tree_t<3>>,
+                                   test_many_tree_t<1, 2, 3>>,
+                "tavl_join_t");
+            using test_concat =
+                tavl_concat_t<typename test_split_found::less,
+                              typename test_split_found::greater>;
+            static_assert(
+                test_avl_valid<test_concat>::value &&
+                    std::is_same_v<
+                        tavl_flatten_t<test_concat>,
+                        test_many_flat_t<1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+                                         12, 14, 15, 16, 17, 18, 19, 20>> &&
+                    std::is_same_v<tavl_concat_t<empty_node, empty_node>,
+                                   empty_node> &&
+                    std::is_same_v<
+                        tavl_concat_t<test_many_tree_t<1, 2>, empty_node>,
+                        test_many_tree_t<1, 2>> &&
+                    std::is_same_v<
+                        tavl_concat_t<empty_node, test_many_tree_t<1, 2>>,
+                        test_many_tree_t<1, 2>>,
+                "tavl_concat_t");
+        } // namespace TestSplitJoin
+        inline namespace TestRange
+        {
+            using test_range_tree =
+                test_many_tree_t<2, 4, 6, 8, 10, 12, 14, 16, 18, 20>;
+            static_assert(
+                std::is_same_v<
+                    typename tavl_lower_bound_t<test_range_tree,
+                                                int_v<8>>::key,
+                    int_v<8>> &&
+                    std::is_same_v<
+                        typename tavl_lower_bound_t<test_range_tree,
+                                                    int_v<9>>::key,
+                        int_v<10>> &&
+                    std::is_same_v<
+                        typename tavl_lower_bound_t<test_range_tree,
+                                                    int_v<1>>::key,
+                        int_v<2>> &&
+                    std::is_same_v<tavl_lower_bound_t<test_range_tree,
+                                                      int_v<21>>,
+                                   empty_node> &&
+                    std::is_same_v<tavl_lower_bound_t<empty_node, int_v<1>>,
+                                   empty_node>,
+                "tavl_lower_bound_t");
+            static_assert(
+                std::is_same_v<
+                    typename tavl_upper_bound_t<test_range_tree,
+                                                int_v<8>>::key,
+                    int_v<10>> &&
+                    std::is_same_v<
+                        typename tavl_upper_bound_t<test_range_tree,
+                                                    int_v<9>>::key,
+                        int_v<10>> &&
+                    std::is_same_v<
+                        typename tavl_upper_bound_t<test_range_tree,
+                                                    int_v<0>>::key,
+                        int_v<2>> &&
+                    std::is_same_v<tavl_upper_bound_t<test_range_tree,
+                                                      int_v<20>>,
+                                   empty_node>,
+                "tavl_upper_bound_t");
+            static_assert(
+                tavl_range_count_v<test_range_tree, int_v<4>, int_v<12>> ==
+                        4 &&
+                    tavl_range_count_v<test_range_tree, int_v<5>, int_v<13>> ==
+                        4 &&
+                    tavl_range_count_v<test_range_tree, int_v<0>, int_v<99>> ==
+                        10 &&
+                    tavl_range_count_v<test_range_tree, int_v<12>, int_v<4>> ==
+                        0 &&
+                    tavl_range_count_v<empty_node, int_v<0>, int_v<9>> == 0,
+                "tavl_range_count_v");
+            using test_range_middle =
+                tavl_range_t<test_range_tree, int_v<5>, int_v<16>>;
+            static_assert(
+                test_avl_valid<test_range_middle>::value &&
+                    std::is_same_v<tavl_flatten_t<test_range_middle>,
+                                   test_many_flat_t<6, 8, 10, 12, 14>> &&
+                    std::is_same_v<tavl_range_t<test_range_tree,
+                                                int_v<0>,
+                                                int_v<99>>,
+                                   test_range_tree> &&
+                    std::is_same_v<tavl_range_t<test_range_tree,
+                                                int_v<12>,
+                                                int_v<4>>,
+                                   empty_node>,
+                "tavl_range_t");
+            static_assert(
+                std::is_same_v<
+                    tavl_range_flat_t<test_range_tree, int_v<4>, int_v<11>>,
+                    test_many_flat_t<4, 6, 8, 10>> &&
+                    std::is_same_v<tavl_range_flat_t<test_range_tree,
+                                                     int_v<21>,
+                                                     int_v<30>>,
+                                   tavl_flat<>>,
+                "tavl_range_flat_t");
+        } // namespace TestRange
+        inline namespace TestFindIf
+        {
+            template <typename K, typename V>
+            struct test_find_even : std::bool_constant<K::value % 2 == 0>
+            {
+            };
+            template <typename K, typename V>
+            struct test_find_positive : std::bool_constant<(K::value > 0)>
+            {
+            };
+            // fails to compile for keys after 5, so the search has to stop
+            template <typename K, typename V>
+            struct test_find_stop_at_5
+            {
+                static_assert(K::value <= 5, "visited after the result");
+                static constexpr bool value = K::value == 5;
+            };
+            using test_find_tree =
+                test_many_tree_t<1, 3, 5, 6, 7, 9, 10, 11, 13, 15, 17>;
+            static_assert(
+                std::is_same_v<
+                    typename tavl_find_if_t<test_find_tree,
+                                            test_find_even>::key,
+                    int_v<6>> &&
+                    std::is_same_v<
+                        typename tavl_find_if_t<test_find_tree,
+                                                test_find_stop_at_5>::key,
+                        int_v<5>> &&
+                    std::is_same_v<
+                        tavl_find_if_t<test_many_tree_t<1, 3, 5>,
+                                       test_find_even>,
+                        empty_node> &&
+                    std::is_same_v<tavl_find_if_t<empty_node, test_find_even>,
+                                   empty_node>,
+                "tavl_find_if_t");
+            static_assert(
+                tavl_any_of_v<test_find_tree, test_find_stop_at_5> &&
+                    !tavl_any_of_v<test_many_tree_t<1, 3>, test_find_even> &&
+                    tavl_all_of_v<test_find_tree, test_find_positive> &&
+                    !tavl_all_of_v<test_find_tree, test_find_even> &&
+                    tavl_all_of_v<empty_node, test_find_even> &&
+                    tavl_none_of_v<test_many_tree_t<1, 3>, test_find_even> &&
+                    !tavl_none_of_v<test_find_tree, test_find_stop_at_5>,
+                "tavl_any_of_v, tavl_all_of_v and tavl_none_of_v");
+            // sums keys in order and stops once the sum reaches 10
+            template <typename S, typename K, typename V>
+            struct test_fold_sum
+            {
+                using type                 = int_v<S::value + K::value>;
+                static constexpr bool done = type::value >= 10;
+            };
+            static_assert(
+                tavl_fold_until_t<test_find_tree, test_fold_sum, int_v<0>>::
+                            value == 15 &&
+                    tavl_fold_until<test_find_tree, test_fold_sum, int_v<0>>::
+                        done &&
+                    tavl_fold_until_t<test_many_tree_t<1, 2, 3>,
+                                      test_fold_sum,
+                                      int_v<0>>::value == 6 &&
+                    !tavl_fold_until<test_many_tree_t<1, 2, 3>,
+                                     test_fold_sum,
+                                     int_v<0>>::done &&
+                    tavl_fold_until_t<empty_node, test_fold_sum, int_v<4>>::
+                            value == 4,
+                "tavl_fold_until");
+        } // namespace TestFindIf
+        inline namespace TestUpsert
+        {
+            template <typename Old>
+            struct test_upsert_inc
+            {
+                using type = int_v<Old::value + 1>;
+            };
+            template <>
+            struct test_upsert_inc<void>
+            {
+                using type = int_v<0>;
+            };
+            template <typename Old>
+            struct test_upsert_keep
+            {
+                using type = Old;
+            };
+            using test_upsert_tree = test_many_tree_t<1, 2, 3, 4, 5, 6, 7>;
+            using test_upsert_inc_4 =
+                tavl_update_with_t<test_upsert_tree, int_v<4>, test_upsert_inc>;
+            static_assert(
+                std::is_same_v<typename tavl_find_t<test_upsert_inc_4,
+                                                    int_v<4>>::value,
+                               int_v<5>> &&
+                    std::is_same_v<typename test_upsert_inc_4::left,
+                                   typename test_upsert_tree::left> &&
+                    std::is_same_v<typename test_upsert_inc_4::right,
+                                   typename test_upsert_tree::right>,
+                "tavl_update_with_t for existing keys");
+            using test_upsert_new =
+                tavl_update_with_t<test_upsert_tree, int_v<8>, test_upsert_inc>;
+            static_assert(
+                test_avl_valid<test_upsert_new>::value &&
+                    std::is_same_v<
+                        tavl_flatten_t<test_upsert_new>,
+                        tavl_flat<kv_pair<int_v<1>, int_v<1>>,
+                                  kv_pair<int_v<2>, int_v<2>>,
+                                  kv_pair<int_v<3>, int_v<3>>,
+                                  kv_pair<int_v<4>, int_v<4>>,
+                                  kv_pair<int_v<5>, int_v<5>>,
+                                  kv_pair<int_v<6>, int_v<6>>,
+                                  kv_pair<int_v<7>, int_v<7>>,
+                                  kv_pair<int_v<8>, int_v<0>>>> &&
+                    std::is_same_v<typename test_upsert_new::left,
+                                   typename test_upsert_tree::left> &&
+                    std::is_same_v<tavl_update_with_t<empty_node,
+                                                      int_v<1>,
+                                                      test_upsert_inc>,
+                                   kv_pair<int_v<1>, int_v<0>>>,
+                "tavl_update_with_t for missing keys");
+            static_assert(
+                std::is_same_v<tavl_update_with_t<test_upsert_tree,
+                                                  int_v<6>,
+                                                  test_upsert_keep>,
+                               test_upsert_tree> &&
+                    std::is_same_v<tavl_insert_or_assign_t<test_upsert_tree,
+                                                           int_v<2>,
+                                                           int_v<2>>,
+                                   test_upsert_tree> &&
+                    std::is_same_v<
+                        tavl_insert_or_assign_t<test_upsert_tree,
+                                                int_v<2>,
+                                                int_v<9>>,
+                        tavl_update_with_t<test_upsert_tree,
+                                           int_v<2>,
+                                           impl::upsert_assign<
+                                               int_v<9>>::template apply>> &&
+                    std::is_same_v<
+                        tavl_flatten_t<tavl_insert_or_assign_t<
+                            test_many_tree_t<1, 3>,
+                            int_v<2>,
+                            int_v<2>>>,
+                        test_many_flat_t<1, 2, 3>>,
+                "tavl_insert_or_assign_t");
+        } // namespace TestUpsert
+        inline namespace TestFixpoint
+        {
+            using test_fix_tree = test_many_tree_t<1, 3, 5, 7, 9>;
+            static_assert(
+                std::is_same_v<tavl_insert_t<test_fix_tree, int_v<5>>,
+                               test_fix_tree> &&
+                    !tavl_insert<test_fix_tree, int_v<5>>::changed &&
+                    tavl_insert<test_fix_tree, int_v<4>>::changed &&
+                    tavl_insert<empty_node, int_v<4>>::changed &&
+                    std::is_same_v<tavl_insert_t<test_fix_tree,
+                                                 int_v<5>,
+                                                 std::true_type,
+                                                 tavl_weight_policy>,
+                                   test_fix_tree>,
+                "tavl_insert for existing keys");
+            static_assert(
+                std::is_same_v<
+                    tavl_union_t<test_fix_tree, test_many_tree_t<3, 9>>,
+                    test_fix_tree> &&
+                    !tavl_union<test_fix_tree,
+                                test_many_tree_t<3, 9>>::changed &&
+                    !tavl_union<test_fix_tree, empty_node>::changed &&
+                    tavl_union<test_fix_tree,
+                               test_many_tree_t<3, 4>>::changed &&
+                    !tavl_union<test_fix_tree,
+                                test_many_tree_t<1>,
+                                test_many_tree_t<7, 9>>::changed &&
+                    std::is_same_v<
+                        tavl_flatten_t<
+                            tavl_union_t<test_fix_tree,
+                                         test_many_tree_t<3, 4>>>,
+                        test_many_flat_t<1, 3, 4, 5, 7, 9>>,
+                "changed flag of tavl_union");
+            // adds the successor of the maximum until 20 is reached
+            template <typename S>
+            using test_fix_grow =
+                tavl_insert<S,
+                            int_v<(tavl_max_t<S>::key::value < 20 ?
+                                       tavl_max_t<S>::key::value + 1 :
+                                       20)>>;
+            // unions S with the doubled keys below 16, without changed
+            template <typename K, typename V>
+            struct test_fix_double
+            {
+                using type = tavl_insert_t<
+                    empty_node,
+                    int_v<(K::value < 8 ? K::value * 2 : K::value)>>;
+            };
+            template <typename S>
+            struct test_fix_double_step
+            {
+                using type = tavl_union_t<
+                    S,
+                    tavl_for_each_t<S,
+                                    test_fix_double,
+                                    tavl_union_3,
+                                    empty_node>>;
+            };
+            static_assert(
+                std::is_same_v<
+                    tavl_flatten_t<
+                        tavl_fixpoint_t<test_fix_grow,
+                                        tavl_insert_t<empty_node, int_v<17>>>>,
+                    tavl_flat<kv_pair<int_v<17>>,
+                              kv_pair<int_v<18>>,
+                              kv_pair<int_v<19>>,
+                              kv_pair<int_v<20>>>> &&
+                    std::is_same_v<tavl_fixpoint_t<test_fix_grow,
+                                                   test_many_tree_t<20>>,
+                                   test_many_tree_t<20>> &&
+                    std::is_same_v<
+                        tavl_flatten_t<
+                            tavl_fixpoint_t<test_fix_double_step,
+                                            tavl_insert_t<empty_node,
+                                                          int_v<1>>>>,
+                        tavl_flat<kv_pair<int_v<1>>,
+                                  kv_pair<int_v<2>>,
+                                  kv_pair<int_v<4>>,
+                                  kv_pair<int_v<8>>>>,
+                "tavl_fixpoint");
+        } // namespace TestFixpoint
+        inline namespace TestToPack
+        {
+            template <typename... Ts>
+            struct test_pack
+            {
+            };
+            template <std::size_t... Is>
+            auto test_pack_make(std::index_sequence<Is...>)
+                -> tavl_from_sorted_t<kv_pair<int_v<Is>, int_v<Is>>...>;
+            using test_pack_large = decltype(
+                test_pack_make(std::make_index_sequence<1000>{}));
+            template <typename S, typename K, typename V>
+            struct test_pack_sum
+            {
+                using type = int_v<S::value + K::value>;
+            };
+            // keeps the keys in the order they are visited
+            template <typename S, typename K, typename V>
+            struct test_pack_order;
+            template <typename... Ks, typename K, typename V>
+            struct test_pack_order<test_pack<Ks...>, K, V>
+            {
+                using type = test_pack<Ks..., K>;
+            };
+            template <typename K, typename V>
+            struct test_pack_value
+            {
+                using type = V;
+            };
+            using test_pack_tree = test_many_tree_t<1, 2, 3, 4, 5, 6, 7>;
+            static_assert(
+                std::is_same_v<tavl_to_pack_t<test_pack_tree, tavl_flat>,
+                               tavl_flatten_t<test_pack_tree>> &&
+                    std::is_same_v<tavl_to_pack_t<empty_node, test_pack>,
+                                   test_pack<>> &&
+                    std::is_same_v<tavl_to_pack_t<test_pack_large, tavl_flat>,
+                                   tavl_flatten_t<test_pack_large>>,
+                "tavl_to_pack_t");
+            static_assert(
+                tavl_fold_t<test_pack_tree, test_pack_sum, int_v<0>>::value ==
+                        28 &&
+                    tavl_fold_t<empty_node, test_pack_sum, int_v<3>>::value ==
+                        3 &&
+                    tavl_fold_t<test_pack_large, test_pack_sum, int_v<0>>::
+                            value == 999 * 1000 / 2 &&
+                    std::is_same_v<
+                        tavl_fold_t<test_pack_tree,
+                                    test_pack_order,
+                                    test_pack<>>,
+                        test_pack<int_v<1>,
+                                  int_v<2>,
+                                  int_v<3>,
+                                  int_v<4>,
+                                  int_v<5>,
+                                  int_v<6>,
+                                  int_v<7>>>,
+                "tavl_fold_t");
+            static_assert(
+                std::is_same_v<tavl_transform_to_pack_t<test_pack_tree,
+                                                        test_pack_value,
+                                                        test_pack>,
+                               test_pack<int_v<1>,
+                                         int_v<2>,
+                                         int_v<3>,
+                                         int_v<4>,
+                                         int_v<5>,
+                                         int_v<6>,
+                                         int_v<7>>>,
+                "tavl_transform_to_pack_t");
+        } // namespace TestToPack
+        inline namespace TestTransform
+        {
+            template <typename K, typename V>
+            struct test_transform_square
+            {
+                using type = int_v<K::value * V::value>;
+            };
+            template <typename K, typename V>
+            struct test_transform_shift
+            {
+                using type = int_v<K::value * 2 + 1>;
+            };
+            using test_transform_tree = test_many_tree_t<1, 2, 3, 4, 5, 6, 7>;
+            using test_transform_values =
+                tavl_transform_values_t<test_transform_tree,
+                                        test_transform_square>;
+            using test_transform_keys =
+                tavl_transform_keys_monotone_t<test_transform_tree,
+                                               test_transform_shift>;
+            static_assert(
+                std::is_same_v<
+                    tavl_flatten_t<test_transform_values>,
+                    tavl_flat<kv_pair<int_v<1>, int_v<1>>,
+                              kv_pair<int_v<2>, int_v<4>>,
+                              kv_pair<int_v<3>, int_v<9>>,
+                              kv_pair<int_v<4>, int_v<16>>,
+                              kv_pair<int_v<5>, int_v<25>>,
+                              kv_pair<int_v<6>, int_v<36>>,
+                              kv_pair<int_v<7>, int_v<49>>>> &&
+                    test_avl_valid<test_transform_values>::value &&
+                    test_transform_values::height ==
+                        test_transform_tree::height &&
+                    std::is_same_v<
+                        tavl_transform_values_t<empty_node,
+                                                test_transform_square>,
+                        empty_node>,
+                "tavl_transform_values_t");
+            static_assert(
+                std::is_same_v<
+                    tavl_flatten_t<test_transform_keys>,
+                    tavl_flat<kv_pair<int_v<3>, int_v<1>>,
+                              kv_pair<int_v<5>, int_v<2>>,
+                              kv_pair<int_v<7>, int_v<3>>,
+                              kv_pair<int_v<9>, int_v<4>>,
+                              kv_pair<int_v<11>, int_v<5>>,
+                              kv_pair<int_v<13>, int_v<6>>,
+                              kv_pair<int_v<15>, int_v<7>>>> &&
+                    std::is_same_v<
+                        typename tavl_find_t<test_transform_keys,
+                                             int_v<9>>::value,
+                        int_v<4>>,
+                "tavl_transform_keys_monotone_t");
+        } // namespace TestTransform
+        inline namespace TestFilter
+        {
+            using test_filter_tree = test_many_tree_t<1, 2, 3, 4, 5, 6, 7, 8,
+                                                      9, 10, 11, 12, 13, 14,
+                                                      15, 16, 17, 18, 19, 20>;
+            using test_filter_even =
+                tavl_filter_t<test_filter_tree, test_find_even>;
+            using test_filter_large =
+                tavl_filter_t<test_pack_large, test_find_even>;
+            static_assert(
+                test_avl_valid<test_filter_even>::value &&
+                    std::is_same_v<tavl_flatten_t<test_filter_even>,
+                                   test_many_flat_t<2, 4, 6, 8, 10, 12, 14,
+                                                    16, 18, 20>> &&
+                    test_avl_valid<test_filter_large>::value &&
+                    test_filter_large::size == 500 &&
+                    std::is_same_v<
+                        tavl_filter_t<test_filter_tree, test_find_positive>,
+                        test_filter_tree> &&
+                    std::is_same_v<
+                        tavl_filter_t<test_many_tree_t<1, 3, 5>,
+                                      test_find_even>,
+                        empty_node> &&
+                    std::is_same_v<tavl_filter_t<empty_node, test_find_even>,
+                                   empty_node>,
+                "tavl_filter_t");
+            using test_partition =
+                tavl_partition<test_filter_tree, test_find_even>;
+            static_assert(
+                std::is_same_v<typename test_partition::matched,
+                               test_filter_even> &&
+                    test_avl_valid<typename test_partition::unmatched>::value &&
+                    std::is_same_v<
+                        tavl_flatten_t<typename test_partition::unmatched>,
+                        test_many_flat_t<1, 3, 5, 7, 9, 11, 13, 15, 17, 19>> &&
+                    std::is_same_v<
+                        typename tavl_partition<test_filter_tree,
+                                                test_find_positive>::matched,
+                        test_filter_tree> &&
+                    std::is_same_v<
+                        typename tavl_partition<test_filter_tree,
+                                                test_find_positive>::unmatched,
+                        empty_node>,
+                "tavl_partition");
+        } // namespace TestFilter
+        inline namespace TestPop
+        {
+            using test_pop_tree = test_many_tree_t<1, 2, 3, 4, 5, 6, 7, 8, 9>;
+            using test_pop_min  = tavl_pop_min<test_pop_tree>;
+            using test_pop_max  = tavl_pop_max<test_pop_tree>;
+            static_assert(
+                std::is_same_v<typename test_pop_min::min,
+                               kv_pair<int_v<1>, int_v<1>>> &&
+                    test_avl_valid<typename test_pop_min::rest>::value &&
+                    std::is_same_v<
+                        tavl_flatten_t<typename test_pop_min::rest>,
+                        test_many_flat_t<2, 3, 4, 5, 6, 7, 8, 9>> &&
+                    std::is_same_v<typename tavl_pop_min<empty_node>::min,
+                                   empty_node> &&
+                    std::is_same_v<typename tavl_pop_min<empty_node>::rest,
+                                   empty_node> &&
+                    std::is_same_v<
+                        typename tavl_pop_min<test_many_tree_t<1>>::rest,
+                        empty_node>,
+                "tavl_pop_min");
+            static_assert(
+                std::is_same_v<typename test_pop_max::max,
+                               kv_pair<int_v<9>, int_v<9>>> &&
+                    test_avl_valid<typename test_pop_max::rest>::value &&
+                    std::is_same_v<
+                        tavl_flatten_t<typename test_pop_max::rest>,
+                        test_many_flat_t<1, 2, 3, 4, 5, 6, 7, 8>> &&
+                    std::is_same_v<typename tavl_pop_max<empty_node>::max,
+                                   empty_node>,
+                "tavl_pop_max");
+            // drains the worklist from the smallest key, summing the keys
+            template <typename S>
+            struct test_pop_drain
+            {
+            private:
+                using popped = tavl_pop_min<typename S::first_type>;
+
+            public:
+                using type =
+                    type_pair<typename popped::rest,
+                              int_v<S::second_type::value +
+                                    popped::min::key::value>>;
+            };
+            template <typename Second>
+            struct test_pop_drain<type_pair<empty_node, Second>>
+            {
+                using type = type_pair<empty_node, Second>;
+            };
+            static_assert(
+                tavl_fixpoint_t<test_pop_drain,
+                                type_pair<test_pop_tree, int_v<0>>>::
+                        second_type::value == 45,
+                "tavl_pop_min as a worklist");
+        } // namespace TestPop
+        inline namespace TestFindMany
+        {
+            template <typename... Ts>
+            struct test_find_many_pack
+            {
+            };
+            using test_find_many_tree = test_many_tree_t<2, 4, 6, 8, 10, 12>;
+            static_assert(
+                std::is_same_v<
+                    tavl_find_many_t<test_find_many_tree,
+                                     test_find_many_pack,
+                                     int_v<10>,
+                                     int_v<3>,
+                                     int_v<2>,
+                                     int_v<10>,
+                                     int_v<12>>,
+                    test_find_many_pack<
+                        tavl_find_t<test_find_many_tree, int_v<10>>,
+                        empty_node,
+                        tavl_find_t<test_find_many_tree, int_v<2>>,
+                        tavl_find_t<test_find_many_tree, int_v<10>>,
+                        tavl_find_t<test_find_many_tree, int_v<12>>>> &&
+                    std::is_same_v<tavl_find_many_t<test_find_many_tree,
+                                                    test_find_many_pack>,
+                                   test_find_many_pack<>> &&
+                    std::is_same_v<tavl_find_many_t<empty_node,
+                                                    test_find_many_pack,
+                                                    int_v<1>>,
+                                   test_find_many_pack<empty_node>>,
+                "tavl_find_many_t");
+            static_assert(
+                tavl_contains_all_v<test_find_many_tree,
+                                    int_v<12>,
+                                    int_v<2>,
+                                    int_v<6>> &&
+                    !tavl_contains_all_v<test_find_many_tree,
+                                         int_v<12>,
+                                         int_v<5>> &&
+                    tavl_contains_all_v<test_find_many_tree> &&
+                    tavl_contains_any_v<test_find_many_tree,
+                                        int_v<5>,
+                                        int_v<8>> &&
+                    !tavl_contains_any_v<test_find_many_tree,
+                                         int_v<1>,
+                                         int_v<13>> &&
+                    !tavl_contains_any_v<test_find_many_tree>,
+                "tavl_contains_all_v and tavl_contains_any_v");
+        } // namespace TestFindMany
     }     // namespace InHeaderDebug
 } // namespace tavl
 int main()